@@ -11,97 +11,128 @@
 #include "bufHashTbl.h"
 #include "exceptions/hash_already_present_exception.h"
 #include "exceptions/hash_not_found_exception.h"
-#include "exceptions/hash_table_exception.h"
 
 namespace badgerdb {
 
-  int BufHashTbl::hash(const File *file, const PageId pageNo) {
-    int tmp, value;
-    tmp = (long) file;  // cast of pointer to the file object to an integer
-    value = (tmp + pageNo) % HTSIZE;
-    return value;
+  int BufHashTbl::hash(const File *file, const PageId pageNo) const {
+    // mix the address of the file object with the page number, then scramble
+    // all 64 bits (splitmix64 finalizer) so that the low bits are well spread
+    std::uint64_t value = (std::uint64_t) (uintptr_t) file;
+    value ^= (std::uint64_t) pageNo * 0x9E3779B97F4A7C15ULL;
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ULL;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBULL;
+    value ^= value >> 31;
+    return (int) (value & mask);
   }
 
-  BufHashTbl::BufHashTbl(int htSize) :
-      HTSIZE(htSize) {
-    // allocate an array of pointers to hashBuckets
-    ht = new hashBucket*[htSize];
+  int BufHashTbl::locate(const File *file, const PageId pageNo) const {
+    int index = hash(file, pageNo);
+    while (ht[index].file != NULL) {
+      if (ht[index].file == file && ht[index].pageNo == pageNo)
+        return index;
+      index = (index + 1) & mask;
+    }
+    return -1;
+  }
+
+  BufHashTbl::BufHashTbl(int htSize) {
+    HTSIZE = 1;
+    while (HTSIZE < htSize)
+      HTSIZE *= 2;
+    mask = HTSIZE - 1;
+    // allocate the array of buckets, all of them empty
+    ht = new hashBucket[HTSIZE];
     for (int i = 0; i < HTSIZE; i++)
-      ht[i] = NULL;
+      ht[i].file = NULL;
+    numEntries = 0;
   }
 
-  BufHashTbl::~BufHashTbl() {
-    for (int i = 0; i < HTSIZE; i++) {
-      hashBucket *tmpBuf = ht[i];
-      while (ht[i]) {
-        tmpBuf = ht[i];
-        ht[i] = ht[i]->next;
-        delete tmpBuf;
-      }
+  void BufHashTbl::grow() {
+    hashBucket *oldHt = ht;
+    int oldSize = HTSIZE;
+    HTSIZE *= 2;
+    mask = HTSIZE - 1;
+    ht = new hashBucket[HTSIZE];
+    for (int i = 0; i < HTSIZE; i++)
+      ht[i].file = NULL;
+    for (int i = 0; i < oldSize; i++) {
+      if (oldHt[i].file == NULL)
+        continue;
+      int index = hash(oldHt[i].file, oldHt[i].pageNo);
+      while (ht[index].file != NULL)
+        index = (index + 1) & mask;
+      ht[index] = oldHt[i];
     }
+    delete[] oldHt;
+  }
+
+  BufHashTbl::~BufHashTbl() {
     delete[] ht;
   }
 
   void BufHashTbl::insert(const File *file, const PageId pageNo,
       const FrameId frameNo) {
+    // keep at least half of the buckets empty so that probe sequences stay
+    // short and always end
+    if (2 * (numEntries + 1) > HTSIZE)
+      grow();
     int index = hash(file, pageNo);
-
-    hashBucket *tmpBuc = ht[index];
-    while (tmpBuc) {
+    while (true) {
+      hashBucket *tmpBuc = &ht[index];
+      if (tmpBuc->file == NULL) {
+        tmpBuc->file = file;
+        tmpBuc->pageNo = pageNo;
+        tmpBuc->frameNo = frameNo;
+        numEntries++;
+        return;
+      }
       if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
         throw HashAlreadyPresentException(tmpBuc->file->filename(),
             tmpBuc->pageNo, tmpBuc->frameNo);
-      tmpBuc = tmpBuc->next;
+      index = (index + 1) & mask;
     }
+  }
 
-    tmpBuc = new hashBucket;
-    if (!tmpBuc)
-      throw HashTableException();
+  bool BufHashTbl::find(const File *file, const PageId pageNo,
+      FrameId &frameNo) const {
+    int index = locate(file, pageNo);
+    if (index < 0)
+      return false;
 
-    tmpBuc->file = (File*) file;
-    tmpBuc->pageNo = pageNo;
-    tmpBuc->frameNo = frameNo;
-    tmpBuc->next = ht[index];
-    ht[index] = tmpBuc;
+    frameNo = ht[index].frameNo; // return frameNo by reference
+    return true;
   }
 
   void BufHashTbl::lookup(const File *file, const PageId pageNo,
       FrameId &frameNo) {
-    int index = hash(file, pageNo);
-    hashBucket *tmpBuc = ht[index];
-    while (tmpBuc) {
-      if (tmpBuc->file == file && tmpBuc->pageNo == pageNo) {
-        frameNo = tmpBuc->frameNo; // return frameNo by reference
-        return;
-      }
-      tmpBuc = tmpBuc->next;
-    }
-
-    throw HashNotFoundException(file->filename(), pageNo);
+    if (find(file, pageNo, frameNo) == false)
+      throw HashNotFoundException(file->filename(), pageNo);
   }
 
   void BufHashTbl::remove(const File *file, const PageId pageNo) {
-
-    int index = hash(file, pageNo);
-    hashBucket *tmpBuc = ht[index];
-    hashBucket *prevBuc = NULL;
-
-    while (tmpBuc) {
-      if (tmpBuc->file == file && tmpBuc->pageNo == pageNo) {
-        if (prevBuc)
-          prevBuc->next = tmpBuc->next;
-        else
-          ht[index] = tmpBuc->next;
-
-        delete tmpBuc;
-        return;
-      } else {
-        prevBuc = tmpBuc;
-        tmpBuc = tmpBuc->next;
-      }
+    int index = locate(file, pageNo);
+    if (index < 0)
+      throw HashNotFoundException(file->filename(), pageNo);
+
+    // Shift back the entries after the removed one that would no longer be
+    // reachable from their home bucket across the hole.
+    int next = index;
+    while (true) {
+      next = (next + 1) & mask;
+      if (ht[next].file == NULL)
+        break;
+      int home = hash(ht[next].file, ht[next].pageNo);
+      bool isBetween = index <= next ?
+          (index < home && home <= next) : (index < home || home <= next);
+      if (isBetween)
+        continue;
+      ht[index] = ht[next];
+      index = next;
     }
-
-    throw HashNotFoundException(file->filename(), pageNo);
+    ht[index].file = NULL;
+    numEntries--;
   }
 
 }
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include "file.h"
 
 namespace badgerdb {
@@ -16,9 +18,9 @@ namespace badgerdb {
    */
   struct hashBucket {
       /**
-       * pointer a file object (more on this below)
+       * pointer a file object (more on this below), NULL if the slot is empty
        */
-      File *file;
+      const File *file;
 
       /**
        * page number within a file
@@ -29,28 +31,40 @@ namespace badgerdb {
        * frame number of page in the buffer pool
        */
       FrameId frameNo;
-
-      /**
-       * Next node in the hash table
-       */
-      hashBucket *next;
   };
 
   /**
    * @brief Hash table class to keep track of pages in the buffer pool
    *
+   * The table uses open addressing with linear probing over an array of
+   * buckets. The array is doubled when an insert would fill more than half of
+   * it, so the table may start at the number of entries it usually holds and
+   * still take any number of them. Removal shifts the following entries of
+   * the probe sequence back instead of leaving tombstones.
+   *
    * @warning This class is not threadsafe.
    */
   class BufHashTbl {
     private:
       /**
-       *	Size of Hash Table
+       *	Size of Hash Table, a power of two
        */
       int HTSIZE;
+
+      /**
+       * HTSIZE - 1, used to reduce hash values to bucket indexes
+       */
+      std::uint64_t mask;
+
       /**
        * Actual Hash table object
        */
-      hashBucket **ht;
+      hashBucket *ht;
+
+      /**
+       * Number of entries in the table
+       */
+      int numEntries;
 
       /**
        * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
@@ -59,11 +73,30 @@ namespace badgerdb {
        * @param pageNo  Page number in the file
        * @return  			Hash value.
        */
-      int hash(const File *file, const PageId pageNo);
+      int hash(const File *file, const PageId pageNo) const;
+
+      /**
+       * returns the index of the bucket holding (file, pageNo), or -1 if the
+       * entry is not in the table
+       *
+       * @param file   	File object
+       * @param pageNo  Page number in the file
+       * @return  			Bucket index.
+       */
+      int locate(const File *file, const PageId pageNo) const;
+
+      /**
+       * Double the number of buckets, inserting the entries again
+       */
+      void grow();
 
     public:
       /**
        * Constructor of BufHashTbl class
+       *
+       * @param htSize  Initial number of buckets, rounded up to a power of
+       *                two. Should be about twice the number of entries
+       *                expected, so that the table rarely grows.
        */
       BufHashTbl(const int htSize); // constructor
 
@@ -79,10 +112,20 @@ namespace badgerdb {
        * @param pageNo 	Page number in the file
        * @param frameNo Frame number assigned to that page of the file
        * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-       * @throws  HashTableException (optional) if could not create a new bucket as running of memory
        */
       void insert(const File *file, const PageId pageNo, const FrameId frameNo);
 
+      /**
+       * Find the frame holding (file, pageNo) without throwing when the page
+       * is not in the buffer pool.
+       *
+       * @param file   	File object
+       * @param pageNo  Page number in the file
+       * @param frameNo Frame number reference, set only if the entry is found
+       * @return  			true if the entry is found, false otherwise
+       */
+      bool find(const File *file, const PageId pageNo, FrameId &frameNo) const;
+
       /**
        * Check if (file, pageNo) is currently in the buffer pool (ie. in
        * the hash table).
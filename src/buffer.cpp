@@ -5,6 +5,9 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <exception>
+#include <future>
 #include <memory>
 #include <iostream>
 #include "string.h"
@@ -13,13 +16,16 @@
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
-#include "exceptions/hash_not_found_exception.h"
 #include "exceptions/invalid_page_exception.h"
 
 namespace badgerdb {
 
-  BufMgr::BufMgr(std::uint32_t bufs) :
-      numBufs(bufs) {
+  constexpr double BufMgr::DEFAULT_CLEAN_SHARE;
+  const int BufMgr::WRITER_INTERVAL_MS;
+
+  BufMgr::BufMgr(std::uint32_t bufs, ReplacementPolicy *policy) :
+      numBufs(bufs), policy(policy), isWriterRunning(false), isWriterStopping(false),
+      writerCleanShare(DEFAULT_CLEAN_SHARE) {
     bufDescTable = new BufDesc[bufs];
 
     for (FrameId i = 0; i < bufs; i++) {
@@ -29,10 +35,18 @@ namespace badgerdb {
 
     bufPool = new Page[bufs];
 
-    int htsize = ((((int) (bufs * 1.2)) * 2) / 2) + 1;
-    hashTable = new BufHashTbl(htsize); // allocate the buffer hash table
+    // Consecutive pages of a file fall into consecutive shards, so each
+    // shard table starts with room for its share of the frames; a table that
+    // gets more pages grows.
+    hashShards = new BufHashShard[NUM_HASH_SHARDS];
+    int shardSize = 2 * ((bufs + NUM_HASH_SHARDS - 1) / NUM_HASH_SHARDS) + 1;
+    for (std::uint32_t i = 0; i < NUM_HASH_SHARDS; i++) {
+      hashShards[i].hashTable = new BufHashTbl(shardSize); // allocate the buffer hash table
+    }
 
-    clockHand = bufs - 1; // point to the end
+    if (this->policy == NULL) {
+      this->policy = new ClockPolicy(bufs);
+    }
   }
 
   BufMgr::~BufMgr() {
@@ -40,13 +54,55 @@ namespace badgerdb {
      * Flushes out all dirty pages and deallocates the buffer pool and
      * the BufDesc table.
      */
+    this->stopBackgroundWriter();
+    delete this->policy;
+    for (std::uint32_t i = 0; i < NUM_HASH_SHARDS; i++) {
+      delete this->hashShards[i].hashTable;
+    }
+    delete[] this->hashShards;
+    delete[] this->bufPool;
+    delete[] this->bufDescTable;
   }
 
-  void BufMgr::advanceClock() {
-    /*
-     * Advance clock to next frame in the buffer pool.
-     */
-    this->clockHand = (this->clockHand + 1) % numBufs;
+  bool BufMgr::claimFrame(FrameId frameNo) {
+    BufDesc *tempBufDesc = &(this->bufDescTable[frameNo]);
+    if (tempBufDesc->latch.try_lock() == false) {
+      return false;
+    }
+    if (tempBufDesc->pinCnt > 0) {
+      tempBufDesc->latch.unlock();
+      return false;
+    }
+    return true;
+  }
+
+  void BufMgr::addFileFrame(FrameId frameNo) {
+    BufDesc *tempBufDesc = &(this->bufDescTable[frameNo]);
+    std::lock_guard<std::mutex> guard(this->fileFramesLatch);
+    std::vector<FrameId> &frames = this->fileFrames[tempBufDesc->file];
+    tempBufDesc->fileFramePos = frames.size();
+    frames.push_back(frameNo);
+  }
+
+  void BufMgr::removeFileFrame(FrameId frameNo) {
+    BufDesc *tempBufDesc = &(this->bufDescTable[frameNo]);
+    std::lock_guard<std::mutex> guard(this->fileFramesLatch);
+    std::unordered_map<const File*, std::vector<FrameId>>::iterator it = this->fileFrames.find(
+        tempBufDesc->file);
+    std::vector<FrameId> &frames = it->second;
+    // move the last frame of the list into the place of the removed one
+    FrameId lastFrameNo = frames.back();
+    frames[tempBufDesc->fileFramePos] = lastFrameNo;
+    this->bufDescTable[lastFrameNo].fileFramePos = tempBufDesc->fileFramePos;
+    frames.pop_back();
+    if (frames.empty()) {
+      this->fileFrames.erase(it);
+    }
+  }
+
+  BufHashShard& BufMgr::getShard(const File *file, const PageId pageNo) {
+    std::uint32_t shardNo = ((uintptr_t) file >> 4) + pageNo;
+    return this->hashShards[shardNo % NUM_HASH_SHARDS];
   }
 
   /**
@@ -57,51 +113,222 @@ namespace badgerdb {
    */
   void BufMgr::allocBuf(FrameId &frame) {
     /*
-     * Allocates a free frame using the clock algorithm; if necessary,
+     * Allocates a free frame chosen by the replacement policy; if necessary,
      * write a dirty page back to disk. Throws BufferExceededException
      * if all buffer frames are pinned. This private method will get called
      * by the readPage() and allocPage() methods described below. Make sure
      * that if the buffer frame allocated has a valid page in it, you remove
      * the appropriate entry from the hash table.
+     *
+     * The policy only proposes frames it could latch unpinned, and
+     * evictFrame() gives a frame up if its page has been pinned since.
      */
-    FrameId pinnedFrameCount = 0;
     while (true) {
-      if (pinnedFrameCount == this->numBufs) {
+      FrameId tempFrameID;
+      if (this->policy->pickVictim(tempFrameID,
+          [this](FrameId frameNo) {return this->claimFrame(frameNo);}) == false) {
         throw BufferExceededException();
       }
-      this->advanceClock();
-      BufDesc *tempBufDesc = &(this->bufDescTable[this->clockHand]);
-      File *tempFile = tempBufDesc->file;
-      PageId tempPageID = tempBufDesc->pageNo;
-      FrameId tempFrameID = tempBufDesc->frameNo;
-      if (tempBufDesc->valid == true) {
-        if (tempBufDesc->refbit == true) {
-          tempBufDesc->refbit = false;
-          continue;
-        }
-        if (tempBufDesc->pinCnt > 0) {
-          pinnedFrameCount++;
-          continue;
+      if (this->evictFrame(tempFrameID) == true) {
+        frame = tempFrameID;
+        return;
+      }
+    }
+  }
+
+  bool BufMgr::evictFrame(FrameId frameNo) {
+    BufDesc *tempBufDesc = &(this->bufDescTable[frameNo]);
+    if (tempBufDesc->valid == false) {
+      return true;
+    }
+    File *tempFile = tempBufDesc->file;
+    PageId tempPageID = tempBufDesc->pageNo;
+    BufHashShard &shard = this->getShard(tempFile, tempPageID);
+    std::unique_lock<std::mutex> shardGuard(shard.latch);
+    if (tempBufDesc->pinCnt > 0) {
+      shardGuard.unlock();
+      tempBufDesc->latch.unlock();
+      return false;
+    }
+    bool isWritten = tempBufDesc->dirty;
+    tempBufDesc->dirty = false;
+    shardGuard.unlock();
+
+    // Write the page back with only the frame latched, so that lookups of
+    // other pages of the shard do not wait for the disk. The page may be
+    // pinned meanwhile, and is then left in the buffer pool.
+    if (isWritten == true) {
+      try {
+        tempFile->writePage(this->bufPool[frameNo]);
+      } catch (...) {
+        shardGuard.lock();
+        tempBufDesc->dirty = true;
+        shardGuard.unlock();
+        tempBufDesc->latch.unlock();
+        throw;
+      }
+      this->bufStats.diskwrites++;
+      if (this->isWriterRunning == true) {
+        // the background writer is behind
+        this->writerCondition.notify_one();
+      }
+    }
+
+    shardGuard.lock();
+    if (tempBufDesc->pinCnt > 0 || tempBufDesc->dirty == true) {
+      shardGuard.unlock();
+      tempBufDesc->latch.unlock();
+      return false;
+    }
+    shard.hashTable->remove(tempFile, tempPageID);
+    this->removeFileFrame(frameNo);
+    tempBufDesc->Clear();
+    this->policy->recordFree(frameNo);
+    return true;
+  }
+
+  bool BufMgr::reuseRingFrame(BufferRing *ring, std::size_t slot, FrameId &frame) {
+    if (ring->files[slot] == NULL) {
+      return false;
+    }
+    FrameId frameNo = ring->frameNos[slot];
+    if (this->claimFrame(frameNo) == false) {
+      return false;
+    }
+    BufDesc *tempBufDesc = &(this->bufDescTable[frameNo]);
+    if (tempBufDesc->valid == true
+        && (tempBufDesc->file != ring->files[slot]
+            || tempBufDesc->pageNo != ring->pageNos[slot])) {
+      // the page of the ring has been evicted and the frame taken by another
+      // page, which the ring must leave alone
+      tempBufDesc->latch.unlock();
+      return false;
+    }
+    if (this->evictFrame(frameNo) == false) {
+      return false;
+    }
+    frame = frameNo;
+    return true;
+  }
+
+  bool BufMgr::isSequentialMiss(const BufferRing *ring, const File *file,
+      const PageId pageNo) {
+    std::size_t lastSlot = (ring->nextSlot + ring->frameNos.size() - 1) % ring->frameNos.size();
+    return ring->files[lastSlot] == file && ring->pageNos[lastSlot] + 1 == pageNo;
+  }
+
+  void BufMgr::readAhead(File *file, const PageId pageNo, Page *&page, BufferRing *ring) {
+    // Gather the run of pages from pageNo on that are not in the buffer pool.
+    // It leaves a slot of the ring out, so that the run does not evict the
+    // page the scan read last, which may still be pinned.
+    std::size_t maxPages = std::min(ring->readAheadSize + 1, ring->frameNos.size() - 1);
+    std::size_t numPages = 1;
+    while (numPages < maxPages) {
+      BufHashShard &shard = this->getShard(file, pageNo + numPages);
+      std::lock_guard<std::mutex> shardGuard(shard.latch);
+      FrameId frameNo;
+      if (shard.hashTable->find(file, pageNo + numPages, frameNo) == true) {
+        break;
+      }
+      numPages++;
+    }
+
+    // Take a latched frame for each page. Reading ahead stops early rather
+    // than fail when no frame is free.
+    std::vector<FrameId> newFrameNos;
+    std::vector<Page*> newPages;
+    try {
+      for (std::size_t i = 0; i < numPages; i++) {
+        FrameId newFrameNo;
+        std::size_t slot = (ring->nextSlot + i) % ring->frameNos.size();
+        if (this->reuseRingFrame(ring, slot, newFrameNo) == false) {
+          if (i == 0) {
+            this->allocBuf(newFrameNo);
+          } else {
+            try {
+              this->allocBuf(newFrameNo);
+            } catch (const BufferExceededException &e) {
+              break;
+            }
+          }
         }
-        if (tempBufDesc->dirty == true) {
-          Page tempPage = this->bufPool[tempFrameID];
-          tempFile->writePage(tempPage);
+        newFrameNos.push_back(newFrameNo);
+        newPages.push_back(&(this->bufPool[newFrameNo]));
+      }
+    } catch (...) {
+      // e.g. the write-back of a dirty victim failed
+      for (std::size_t i = 0; i < newFrameNos.size(); i++) {
+        this->bufDescTable[newFrameNos[i]].latch.unlock();
+      }
+      throw;
+    }
+
+    // the run is read with a single vectored read, on this thread
+    std::size_t numRead = 0;
+    try {
+      numRead = file->readPages(pageNo, &newPages[0], newPages.size());
+    } catch (...) {
+      for (std::size_t i = 0; i < newFrameNos.size(); i++) {
+        this->bufDescTable[newFrameNos[i]].latch.unlock();
+      }
+      throw;
+    }
+    if (numRead == 0 || newPages[0]->page_number() != pageNo) {
+      for (std::size_t i = 0; i < newFrameNos.size(); i++) {
+        this->bufDescTable[newFrameNos[i]].latch.unlock();
+      }
+      throw InvalidPageException(pageNo, file->filename());
+    }
+    this->bufStats.accesses++;
+    this->bufStats.misses++;
+    this->bufStats.diskreads += numRead;
+
+    for (std::size_t i = 0; i < newFrameNos.size(); i++) {
+      FrameId newFrameNo = newFrameNos[i];
+      std::lock_guard<std::mutex> frameGuard(this->bufDescTable[newFrameNo].latch,
+          std::adopt_lock);
+      std::size_t slot = (ring->nextSlot + i) % ring->frameNos.size();
+      ring->files[slot] = NULL;
+      if (i >= numRead || newPages[i]->page_number() != pageNo + i) {
+        // past the end of the file or a free page; leave the frame free
+        continue;
+      }
+      BufHashShard &shard = this->getShard(file, pageNo + i);
+      std::lock_guard<std::mutex> shardGuard(shard.latch);
+      FrameId frameNo;
+      if (shard.hashTable->find(file, pageNo + i, frameNo) == true) {
+        // Another thread has read the page meanwhile; leave the new frame free
+        if (i == 0) {
+          this->policy->recordHit(frameNo);
+          this->bufDescTable[frameNo].pinCnt++;
+          page = &(this->bufPool[frameNo]);
         }
-        this->hashTable->remove(tempFile, tempPageID);
-        this->bufDescTable[tempFrameID].Clear();
+        continue;
+      }
+      shard.hashTable->insert(file, pageNo + i, newFrameNo);
+      this->bufDescTable[newFrameNo].Set(file, pageNo + i);
+      if (i > 0) {
+        this->bufDescTable[newFrameNo].pinCnt = 0;
+      }
+      this->addFileFrame(newFrameNo);
+      this->policy->recordLoad(newFrameNo, file, pageNo + i);
+      ring->frameNos[slot] = newFrameNo;
+      ring->files[slot] = file;
+      ring->pageNos[slot] = pageNo + i;
+      if (i == 0) {
+        page = &(this->bufPool[newFrameNo]);
       }
-      frame = tempFrameID;
-      return;
     }
+    ring->nextSlot = (ring->nextSlot + newFrameNos.size()) % ring->frameNos.size();
   }
 
-  void BufMgr::readPage(File *file, const PageId pageNo, Page *&page) {
+  void BufMgr::readPage(File *file, const PageId pageNo, Page *&page,
+      BufferRing *ring) {
     /*
      * First check whether the page is already in the buffer pool by
-     * invoking the lookup() method, which may throw HashNotFoundException
-     * when page is not in the buffer pool, on the hashtable to get a frame
-     * number. There are two cases to be handled depending on the outcome of
-     * the lookup() call:
+     * invoking the find() method on the hashtable to get a frame number.
+     * There are two cases to be handled depending on the outcome of the
+     * find() call:
      *
      * Case 1: Page is not in the buffer pool.
      * Call allocBuf() to allocate a buffer frame and then call the method
@@ -112,23 +339,66 @@ namespace badgerdb {
      * parameter.
      *
      * Case 2: Page is in the buffer pool.
-     * In this case set the appropriate refbit, increment the pinCnt for the
+     * In this case record the hit with the replacement policy, increment the pinCnt for the
      * page, and then return a pointer to the frame containing the page via
      * the page parameter.
+     *
+     * In case 1, a scan reading through a ring takes the frame of the next
+     * slot of the ring, if it still holds the page the scan loaded into it,
+     * and reads ahead if the miss is sequential. The read is done on the
+     * calling thread, since it has nothing to overlap with.
      */
+    BufHashShard &shard = this->getShard(file, pageNo);
     FrameId frameNo;
-    try {
-      // exception is not caught. Page is in the buffer pool
-      this->hashTable->lookup(file, pageNo, frameNo);
-      this->bufDescTable[frameNo].refbit = true;
+    {
+      std::lock_guard<std::mutex> shardGuard(shard.latch);
+      if (shard.hashTable->find(file, pageNo, frameNo) == true) {
+        // Page is in the buffer pool
+        this->bufStats.accesses++;
+        this->bufStats.hits++;
+        this->policy->recordHit(frameNo);
+        this->bufDescTable[frameNo].pinCnt++;
+        page = &(this->bufPool[frameNo]);
+        return;
+      }
+    }
+
+    // Page is not in the buffer pool. Read it into a latched frame, which no
+    // other thread can see until the page is inserted into the hash table.
+    if (ring != NULL && ring->readAheadSize > 0 && ring->frameNos.size() > 2
+        && this->isSequentialMiss(ring, file, pageNo) == true) {
+      this->readAhead(file, pageNo, page, ring);
+      return;
+    }
+    FrameId newFrameNo;
+    if (ring == NULL || this->reuseRingFrame(ring, ring->nextSlot, newFrameNo) == false) {
+      this->allocBuf(newFrameNo);
+    }
+    std::lock_guard<std::mutex> frameGuard(this->bufDescTable[newFrameNo].latch,
+        std::adopt_lock);
+    file->readPage(pageNo, this->bufPool[newFrameNo]);
+    this->bufStats.accesses++;
+    this->bufStats.misses++;
+    this->bufStats.diskreads++;
+
+    std::lock_guard<std::mutex> shardGuard(shard.latch);
+    if (shard.hashTable->find(file, pageNo, frameNo) == true) {
+      // Another thread has read the page meanwhile; leave the new frame free
+      this->policy->recordHit(frameNo);
       this->bufDescTable[frameNo].pinCnt++;
-    } catch (const HashNotFoundException &e) {
-      // if exception is caught, page is not in the buffer pool
-      this->allocBuf(frameNo);
-      Page tempPage = file->readPage(pageNo);
-      this->hashTable->insert(file, pageNo, frameNo);
+    } else {
+      frameNo = newFrameNo;
+      shard.hashTable->insert(file, pageNo, frameNo);
       this->bufDescTable[frameNo].Set(file, pageNo);
-      this->bufPool[frameNo] = tempPage;
+      this->addFileFrame(frameNo);
+      this->policy->recordLoad(frameNo, file, pageNo);
+      if (ring != NULL) {
+        std::size_t slot = ring->nextSlot;
+        ring->frameNos[slot] = frameNo;
+        ring->files[slot] = file;
+        ring->pageNos[slot] = pageNo;
+        ring->nextSlot = (slot + 1) % ring->frameNos.size();
+      }
     }
     page = &(this->bufPool[frameNo]);
   }
@@ -139,21 +409,21 @@ namespace badgerdb {
      * dirty == true, sets the dirty bit. Throws PAGENOTPINNED if the pin count
      * is already 0. Does nothing if page is not found in the hash table lookup.
      */
+    BufHashShard &shard = this->getShard(file, pageNo);
+    std::lock_guard<std::mutex> shardGuard(shard.latch);
     FrameId frameNo;
-    try {
-      this->hashTable->lookup(file, pageNo, frameNo); // exception may be caught
-      BufDesc *tempBufDesc = &(this->bufDescTable[frameNo]);
-      if (dirty == true) {
-        tempBufDesc->dirty = true;
-      }
-      if (tempBufDesc->pinCnt == 0) {
-        throw PageNotPinnedException(file->filename(), pageNo, frameNo);
-      } else {
-        tempBufDesc->pinCnt--;
-      }
-    } catch (const HashNotFoundException &e) {
+    if (shard.hashTable->find(file, pageNo, frameNo) == false) {
       return;
     }
+    BufDesc *tempBufDesc = &(this->bufDescTable[frameNo]);
+    if (dirty == true) {
+      tempBufDesc->dirty = true;
+    }
+    if (tempBufDesc->pinCnt == 0) {
+      throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+    } else {
+      tempBufDesc->pinCnt--;
+    }
   }
 
   void BufMgr::flushFile(const File *file) {
@@ -165,32 +435,211 @@ namespace badgerdb {
      * and (c) invoke the Clear() method of BufDesc for the page frame. Throws
      * PagePinnedException if some page of the file is pinned. Throws
      * BadBufferException if an invalid page belonging to the file is encountered.
+     *
+     * Only the frames in the list of the file are visited. A frame may have
+     * been evicted after the list was copied, so each one is checked again
+     * under its latch. The frames are latched in order of frame number, and
+     * the dirty pages of each hash shard are written by the I/O engine at the
+     * same time. The shard is latched only to take the dirty pages and to
+     * remove them afterwards, not while they are written.
      */
-    for (unsigned int i = 0; i < this->numBufs; i++) {
-      BufDesc *tempBufDesc = &(this->bufDescTable[i]);
-      FrameId tempFrameNo = tempBufDesc->frameNo;
-      PageId tempPageNo = tempBufDesc->pageNo;
-      File *tempFile = tempBufDesc->file;
-      if (tempFile == NULL || file->filename() != tempFile->filename()) {
+    std::vector<FrameId> frames;
+    {
+      std::lock_guard<std::mutex> guard(this->fileFramesLatch);
+      std::unordered_map<const File*, std::vector<FrameId>>::const_iterator it =
+          this->fileFrames.find(file);
+      if (it == this->fileFrames.end()) {
+        return;
+      }
+      frames = it->second;
+    }
+    std::sort(frames.begin(), frames.end());
+
+    // Latch the frames still holding pages of the file, up to the first one
+    // that cannot be flushed.
+    std::exception_ptr error;
+    std::vector<std::pair<BufHashShard*, FrameId> > latchedFrames;
+    for (std::size_t i = 0; i < frames.size(); i++) {
+      BufDesc *tempBufDesc = &(this->bufDescTable[frames[i]]);
+      tempBufDesc->latch.lock();
+      if (tempBufDesc->file != file) {
+        tempBufDesc->latch.unlock();
         continue;
       }
       if (tempBufDesc->valid == false) {
-        throw BadBufferException(tempFrameNo, tempBufDesc->dirty, false,
-            tempBufDesc->refbit);
+        tempBufDesc->latch.unlock();
+        error = std::make_exception_ptr(
+            BadBufferException(tempBufDesc->frameNo, tempBufDesc->dirty, false, false));
+        break;
       }
       if (tempBufDesc->pinCnt > 0) {
-        throw PagePinnedException(file->filename(), tempPageNo, tempFrameNo);
+        tempBufDesc->latch.unlock();
+        error = std::make_exception_ptr(
+            PagePinnedException(file->filename(), tempBufDesc->pageNo, tempBufDesc->frameNo));
+        break;
       }
-      // step (a)
-      if (tempBufDesc->dirty == true) {
-        Page tempPage = this->bufPool[tempFrameNo];
-        tempFile->writePage(tempPage);
-        tempBufDesc->dirty = false;
+      latchedFrames.push_back(
+          std::make_pair(&(this->getShard(tempBufDesc->file, tempBufDesc->pageNo)),
+              tempBufDesc->frameNo));
+    }
+    std::sort(latchedFrames.begin(), latchedFrames.end());
+
+    for (std::size_t begin = 0; begin < latchedFrames.size();) {
+      BufHashShard &shard = *(latchedFrames[begin].first);
+      std::size_t end = begin;
+      while (end < latchedFrames.size() && latchedFrames[end].first == &shard) {
+        end++;
+      }
+      // step (a), the dirty pages of the shard being written with only their
+      // frames latched, so that lookups in the shard do not wait for the disk
+      std::vector<std::future<void> > writes(end - begin);
+      {
+        std::lock_guard<std::mutex> shardGuard(shard.latch);
+        for (std::size_t i = begin; i < end; i++) {
+          BufDesc *tempBufDesc = &(this->bufDescTable[latchedFrames[i].second]);
+          if (tempBufDesc->dirty == true) {
+            tempBufDesc->dirty = false;
+            File *tempFile = tempBufDesc->file;
+            Page *tempPage = &(this->bufPool[tempBufDesc->frameNo]);
+            writes[i - begin] = this->ioEngine.submit([tempFile, tempPage]() {
+              tempFile->writePage(*tempPage);
+            });
+          }
+        }
+      }
+      std::vector<bool> isWriteFailed(end - begin, false);
+      for (std::size_t i = begin; i < end; i++) {
+        if (writes[i - begin].valid() == true) {
+          try {
+            writes[i - begin].get();
+            this->bufStats.diskwrites++;
+          } catch (...) {
+            if (error == nullptr) {
+              error = std::current_exception();
+            }
+            isWriteFailed[i - begin] = true;
+          }
+        }
+      }
+
+      std::lock_guard<std::mutex> shardGuard(shard.latch);
+      for (std::size_t i = begin; i < end; i++) {
+        BufDesc *tempBufDesc = &(this->bufDescTable[latchedFrames[i].second]);
+        std::lock_guard<std::mutex> frameGuard(tempBufDesc->latch, std::adopt_lock);
+        if (isWriteFailed[i - begin] == true) {
+          tempBufDesc->dirty = true;
+          continue;
+        }
+        if (tempBufDesc->pinCnt > 0 || tempBufDesc->dirty == true) {
+          // the page has been pinned while it was written
+          if (error == nullptr) {
+            error = std::make_exception_ptr(PagePinnedException(file->filename(),
+                tempBufDesc->pageNo, tempBufDesc->frameNo));
+          }
+          continue;
+        }
+        // step (b)
+        shard.hashTable->remove(tempBufDesc->file, tempBufDesc->pageNo);
+        this->removeFileFrame(tempBufDesc->frameNo);
+        // step (c)
+        FrameId tempFrameNo = tempBufDesc->frameNo;
+        tempBufDesc->Clear();
+        this->policy->recordFree(tempFrameNo);
+      }
+      begin = end;
+    }
+
+    if (error != nullptr) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  void BufMgr::readPages(File *file, const std::vector<PageId> &pageNos,
+      std::vector<Page*> &pages) {
+    /*
+     * Pins the pages already in the buffer pool as readPage() does, and
+     * takes a latched frame for each of the others, into which the I/O
+     * engine reads the page while the next frames are taken. Then the read
+     * pages are installed and pinned in order. If some page cannot be read,
+     * the pages pinned so far are unpinned again and the exception is
+     * rethrown.
+     */
+    pages.assign(pageNos.size(), (Page*) NULL);
+    std::vector<FrameId> newFrameNos(pageNos.size());
+    std::vector<std::future<void> > reads(pageNos.size());
+    std::exception_ptr error;
+    for (std::size_t i = 0; i < pageNos.size(); i++) {
+      BufHashShard &shard = this->getShard(file, pageNos[i]);
+      {
+        std::lock_guard<std::mutex> shardGuard(shard.latch);
+        FrameId frameNo;
+        if (shard.hashTable->find(file, pageNos[i], frameNo) == true) {
+          this->bufStats.accesses++;
+          this->bufStats.hits++;
+          this->policy->recordHit(frameNo);
+          this->bufDescTable[frameNo].pinCnt++;
+          pages[i] = &(this->bufPool[frameNo]);
+          continue;
+        }
+      }
+      try {
+        this->allocBuf(newFrameNos[i]);
+      } catch (...) {
+        error = std::current_exception();
+        break;
+      }
+      Page *newPage = &(this->bufPool[newFrameNos[i]]);
+      PageId pageNo = pageNos[i];
+      reads[i] = this->ioEngine.submit([file, pageNo, newPage]() {
+        file->readPage(pageNo, *newPage);
+      });
+    }
+
+    for (std::size_t i = 0; i < pageNos.size(); i++) {
+      if (reads[i].valid() == false) {
+        continue;
+      }
+      FrameId newFrameNo = newFrameNos[i];
+      std::lock_guard<std::mutex> frameGuard(this->bufDescTable[newFrameNo].latch,
+          std::adopt_lock);
+      try {
+        reads[i].get();
+      } catch (...) {
+        // leave the frame free
+        if (error == nullptr) {
+          error = std::current_exception();
+        }
+        continue;
+      }
+      this->bufStats.accesses++;
+      this->bufStats.misses++;
+      this->bufStats.diskreads++;
+      BufHashShard &shard = this->getShard(file, pageNos[i]);
+      std::lock_guard<std::mutex> shardGuard(shard.latch);
+      FrameId frameNo;
+      if (shard.hashTable->find(file, pageNos[i], frameNo) == true) {
+        // Another thread, or an earlier entry of pageNos, has read the page
+        // meanwhile; leave the new frame free
+        this->policy->recordHit(frameNo);
+        this->bufDescTable[frameNo].pinCnt++;
+      } else {
+        frameNo = newFrameNo;
+        shard.hashTable->insert(file, pageNos[i], frameNo);
+        this->bufDescTable[frameNo].Set(file, pageNos[i]);
+        this->addFileFrame(frameNo);
+        this->policy->recordLoad(frameNo, file, pageNos[i]);
+      }
+      pages[i] = &(this->bufPool[frameNo]);
+    }
+
+    if (error != nullptr) {
+      for (std::size_t i = 0; i < pageNos.size(); i++) {
+        if (pages[i] != NULL) {
+          this->unPinPage(file, pageNos[i], false);
+          pages[i] = NULL;
+        }
       }
-      // step (b)
-      this->hashTable->remove(file, tempPageNo);
-      // step (c)
-      tempBufDesc->Clear();
+      std::rethrow_exception(error);
     }
   }
 
@@ -205,14 +654,20 @@ namespace badgerdb {
      * pageNo parameter and a pointer to the buffer frame allocated for the page
      * via the page parameter.
      */
-    Page newPage = file->allocatePage();
-    pageNo = newPage.page_number();
-
     FrameId frameNo;
     this->allocBuf(frameNo);
-    this->hashTable->insert(file, pageNo, frameNo);
+    std::lock_guard<std::mutex> frameGuard(this->bufDescTable[frameNo].latch,
+        std::adopt_lock);
+    this->bufPool[frameNo] = file->allocatePage();
+    pageNo = this->bufPool[frameNo].page_number();
+    BufHashShard &shard = this->getShard(file, pageNo);
+    std::lock_guard<std::mutex> shardGuard(shard.latch);
+    shard.hashTable->insert(file, pageNo, frameNo);
     this->bufDescTable[frameNo].Set(file, pageNo);
-    this->bufPool[frameNo] = newPage;
+    this->addFileFrame(frameNo);
+    this->policy->recordLoad(frameNo, file, pageNo);
+    this->bufStats.accesses++;
+    this->bufStats.diskreads++;
 
 //    std::cout << "frameNo: " << frameNo << "\n";
     page = &(this->bufPool[frameNo]);
@@ -225,21 +680,154 @@ namespace badgerdb {
      * a frame in the buffer pool, that frame is freed and correspondingly
      * entry from hash table is also removed.
      */
-    try {
-      FrameId frameNo = this->numBufs + 1;
-      this->hashTable->lookup(file, pageNo, frameNo);
-      if (frameNo == this->numBufs + 1) {
-        return;
+    BufHashShard &shard = this->getShard(file, pageNo);
+    FrameId frameNo;
+    bool isFound;
+    {
+      std::lock_guard<std::mutex> shardGuard(shard.latch);
+      isFound = shard.hashTable->find(file, pageNo, frameNo);
+    }
+    if (isFound == true) {
+      // latch the frame first, then check that it still holds the page
+      std::lock_guard<std::mutex> frameGuard(this->bufDescTable[frameNo].latch);
+      std::lock_guard<std::mutex> shardGuard(shard.latch);
+      FrameId currentFrameNo;
+      if (shard.hashTable->find(file, pageNo, currentFrameNo) == true
+          && currentFrameNo == frameNo) {
+        shard.hashTable->remove(file, pageNo);
+        this->removeFileFrame(frameNo);
+        this->bufDescTable[frameNo].Clear();
+        this->policy->recordFree(frameNo);
       }
-      this->bufDescTable[frameNo].Clear();
-      this->hashTable->remove(file, pageNo);
-      //    delete this->bufPool[frameNo];
-      // is this correct ? As we don't worry about the memory problem, I'll just left it here.
-    } catch (const HashNotFoundException &e) {
     }
     file->deletePage(pageNo);
   }
 
+  void BufMgr::startBackgroundWriter(double cleanShare) {
+    std::lock_guard<std::mutex> guard(this->writerLatch);
+    if (this->isWriterRunning == true) {
+      return;
+    }
+    this->writerCleanShare = cleanShare;
+    this->isWriterStopping = false;
+    this->isWriterRunning = true;
+    this->writerThread = std::thread(&BufMgr::runBackgroundWriter, this);
+  }
+
+  void BufMgr::stopBackgroundWriter() {
+    {
+      std::lock_guard<std::mutex> guard(this->writerLatch);
+      if (this->isWriterRunning == false) {
+        return;
+      }
+      this->isWriterStopping = true;
+    }
+    this->writerCondition.notify_one();
+    this->writerThread.join();
+    this->isWriterRunning = false;
+  }
+
+  void BufMgr::runBackgroundWriter() {
+    std::unique_lock<std::mutex> guard(this->writerLatch);
+    while (this->isWriterStopping == false) {
+      guard.unlock();
+      this->cleanFrames();
+      guard.lock();
+      if (this->isWriterStopping == true) {
+        break;
+      }
+      this->writerCondition.wait_for(guard, std::chrono::milliseconds(WRITER_INTERVAL_MS));
+    }
+  }
+
+  void BufMgr::cleanFrames() {
+    // Look at the frames the policy evicts next, rather than the whole pool,
+    // and latch the ones holding a page that are not in use, which keeps
+    // them from being evicted while they are written.
+    std::vector<FrameId> victims;
+    this->policy->nextVictims(
+        std::max((std::size_t) (this->writerCleanShare * this->numBufs), (std::size_t) 1),
+        victims);
+    std::vector<std::pair<std::pair<File*, PageId>, FrameId> > victimFrames;
+    for (std::size_t i = 0; i < victims.size(); i++) {
+      if (this->claimFrame(victims[i]) == false) {
+        continue;
+      }
+      BufDesc *tempBufDesc = &(this->bufDescTable[victims[i]]);
+      if (tempBufDesc->valid == true) {
+        victimFrames.push_back(
+            std::make_pair(std::make_pair(tempBufDesc->file, tempBufDesc->pageNo),
+                victims[i]));
+      } else {
+        tempBufDesc->latch.unlock();
+      }
+    }
+    if (victimFrames.empty() == true) {
+      return;
+    }
+
+    // Copy the dirty pages in order of file and page number, and mark them
+    // clean. The pages may be pinned and changed again while the copies are
+    // written, which marks them dirty again.
+    std::sort(victimFrames.begin(), victimFrames.end());
+    std::vector<Page> copies;
+    copies.reserve(victimFrames.size());
+    std::vector<FrameId> copiedFrames;
+    for (std::size_t i = 0; i < victimFrames.size(); i++) {
+      BufDesc *tempBufDesc = &(this->bufDescTable[victimFrames[i].second]);
+      BufHashShard &shard = this->getShard(tempBufDesc->file, tempBufDesc->pageNo);
+      std::lock_guard<std::mutex> shardGuard(shard.latch);
+      if (tempBufDesc->pinCnt > 0 || tempBufDesc->dirty == false) {
+        tempBufDesc->latch.unlock();
+        continue;
+      }
+      copies.push_back(this->bufPool[tempBufDesc->frameNo]);
+      copiedFrames.push_back(tempBufDesc->frameNo);
+      tempBufDesc->dirty = false;
+    }
+
+    // Submit each run of consecutive pages of a file as one write
+    std::vector<std::pair<std::size_t, std::size_t> > runs;
+    std::vector<std::future<void> > writes;
+    for (std::size_t begin = 0; begin < copies.size();) {
+      File *file = this->bufDescTable[copiedFrames[begin]].file;
+      std::size_t end = begin + 1;
+      while (end < copies.size() && this->bufDescTable[copiedFrames[end]].file == file
+          && copies[end].page_number() == copies[end - 1].page_number() + 1) {
+        end++;
+      }
+      const Page *runPages = &(copies[begin]);
+      std::size_t runSize = end - begin;
+      writes.push_back(this->ioEngine.submit([file, runPages, runSize]() {
+        file->writePages(runPages, runSize);
+      }));
+      runs.push_back(std::make_pair(begin, end));
+      begin = end;
+    }
+
+    for (std::size_t i = 0; i < runs.size(); i++) {
+      bool isWritten = true;
+      try {
+        writes[i].get();
+      } catch (...) {
+        // a page has been deleted from the file; whoever evicts or flushes
+        // it gets the error
+        isWritten = false;
+      }
+      for (std::size_t j = runs[i].first; j < runs[i].second; j++) {
+        BufDesc *tempBufDesc = &(this->bufDescTable[copiedFrames[j]]);
+        if (isWritten == true) {
+          this->bufStats.diskwrites++;
+        } else {
+          BufHashShard &shard = this->getShard(tempBufDesc->file, tempBufDesc->pageNo);
+          std::lock_guard<std::mutex> shardGuard(shard.latch);
+          tempBufDesc->dirty = true;
+        }
+        tempBufDesc->latch.unlock();
+      }
+    }
+  }
+
   void BufMgr::printSelf(void) {
     BufDesc *tmpbuf;
     int validFrames = 0;
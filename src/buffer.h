@@ -7,10 +7,18 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "io_engine.h"
+#include "replacement_policy.h"
 
 namespace badgerdb {
 
@@ -21,6 +29,10 @@ namespace badgerdb {
 
   /**
    * @brief Class for maintaining information about buffer pool frames
+   *
+   * file, pageNo, valid and dirty of a frame holding a page are only changed
+   * with both the frame latch and the latch of the page's hash shard held,
+   * except that unPinPage() sets dirty under the shard latch alone.
    */
   class BufDesc {
 
@@ -43,9 +55,10 @@ namespace badgerdb {
       FrameId frameNo;
 
       /**
-       * Number of times this page has been pinned
+       * Number of times this page has been pinned. Changed under the latch of
+       * the page's hash shard, but may be read without it.
        */
-      int pinCnt;
+      std::atomic<int> pinCnt;
 
       /**
        * True if page is dirty;  false otherwise
@@ -58,9 +71,14 @@ namespace badgerdb {
       bool valid;
 
       /**
-       * Has this buffer frame been reference recently
+       * Latch held while the frame is being evicted, filled or flushed
        */
-      bool refbit;
+      std::mutex latch;
+
+      /**
+       * Position of the frame in the list of frames of its file
+       */
+      std::size_t fileFramePos;
 
       /**
        * Initialize buffer frame for a new user
@@ -70,7 +88,6 @@ namespace badgerdb {
         file = NULL;
         pageNo = Page::INVALID_NUMBER;
         dirty = false;
-        refbit = false;
         valid = false;
       }
       ;
@@ -89,7 +106,6 @@ namespace badgerdb {
         pinCnt = 1;
         dirty = false;
         valid = true;
-        refbit = true;
       }
 
       void Print() {
@@ -100,9 +116,8 @@ namespace badgerdb {
           std::cout << "file:NULL ";
 
         std::cout << "valid:" << valid << " ";
-        std::cout << "pinCnt:" << pinCnt << " ";
-        std::cout << "dirty:" << dirty << " ";
-        std::cout << "refbit:" << refbit << "\n";
+        std::cout << "pinCnt:" << pinCnt.load() << " ";
+        std::cout << "dirty:" << dirty << "\n";
       }
 
       /**
@@ -120,23 +135,44 @@ namespace badgerdb {
       /**
        * Total number of accesses to buffer pool
        */
-      int accesses;
+      std::atomic<int> accesses;
+
+      /**
+       * Number of reads of pages found in the buffer pool
+       */
+      std::atomic<int> hits;
+
+      /**
+       * Number of reads of pages not found in the buffer pool
+       */
+      std::atomic<int> misses;
 
       /**
        * Number of pages read from disk (including allocs)
        */
-      int diskreads;
+      std::atomic<int> diskreads;
 
       /**
        * Number of pages written back to disk
        */
-      int diskwrites;
+      std::atomic<int> diskwrites;
 
       /**
        * Clear all values
        */
       void clear() {
-        accesses = diskreads = diskwrites = 0;
+        accesses = hits = misses = diskreads = diskwrites = 0;
+      }
+
+      /**
+       * Print all values
+       */
+      void print() const {
+        std::cout << "accesses:" << accesses.load() << " ";
+        std::cout << "hits:" << hits.load() << " ";
+        std::cout << "misses:" << misses.load() << " ";
+        std::cout << "diskreads:" << diskreads.load() << " ";
+        std::cout << "diskwrites:" << diskwrites.load() << "\n";
       }
 
       /**
@@ -147,15 +183,114 @@ namespace badgerdb {
       }
   };
 
+  /**
+   * @brief Small ring of frames a sequential scan reads its pages into
+   *
+   * A scan reading through a ring reuses the frames it has loaded before
+   * instead of taking new ones from the replacement policy, so it never
+   * evicts more than the ring size of the other pages in the pool. Pages
+   * already in the pool are used where they are. A ring belongs to a single
+   * scan and must not be shared between threads.
+   *
+   * A ring may also read ahead: when the scan misses the page following the
+   * last one loaded into the ring, that page and up to readAheadSize pages
+   * after it that are not in the pool are read with one vectored read into
+   * the next frames of the ring.
+   */
+  class BufferRing {
+
+      friend class BufMgr;
+
+    private:
+      /**
+       * Frame of each slot
+       */
+      std::vector<FrameId> frameNos;
+
+      /**
+       * File of the page loaded into the frame of each slot, NULL if the slot
+       * is not used yet
+       */
+      std::vector<File*> files;
+
+      /**
+       * Page loaded into the frame of each slot
+       */
+      std::vector<PageId> pageNos;
+
+      /**
+       * Slot to load the next page into
+       */
+      std::size_t nextSlot;
+
+      /**
+       * Number of pages to read ahead of a sequential miss, 0 not to read
+       * ahead
+       */
+      std::size_t readAheadSize;
+
+    public:
+      /**
+       * Default number of frames of a ring
+       */
+      static const std::size_t DEFAULT_SIZE = 16;
+
+      /**
+       * Default number of pages to read ahead
+       */
+      static const std::size_t DEFAULT_READ_AHEAD = 8;
+
+      /**
+       * Constructor of BufferRing class
+       *
+       * @param size        Number of frames of the ring
+       * @param readAhead   Number of pages to read ahead, at most size - 2 are
+       *                    used so that a read does not evict its own pages
+       */
+      BufferRing(std::size_t size = DEFAULT_SIZE, std::size_t readAhead = DEFAULT_READ_AHEAD) :
+          frameNos(size, 0), files(size, (File*) NULL), pageNos(size, 0), nextSlot(0),
+          readAheadSize(readAhead) {
+      }
+  };
+
+  /**
+   * @brief Partition of the hash table mapping (File, page) to frame, with
+   *        its own latch
+   */
+  struct BufHashShard {
+      /**
+       * Latch protecting the hash table and the pin counts of its pages
+       */
+      std::mutex latch;
+
+      /**
+       * Hash table of the pages falling into this shard
+       */
+      BufHashTbl *hashTable;
+  };
+
   /**
    * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file
+   *
+   * The buffer manager may be shared by several threads. The hash table is
+   * split into shards latched separately, and a frame is latched only while
+   * it is being evicted, filled or flushed, so threads touching different
+   * pages rarely wait for each other. A frame latch is always taken before a
+   * shard latch.
+   *
+   * The frames to evict are chosen by a replacement policy given to the
+   * constructor.
+   *
+   * A background writer thread may be started to write dirty pages back
+   * before their frames are needed, so that readPage() and allocPage() seldom
+   * wait for a write when they evict a page.
    */
   class BufMgr {
     private:
       /**
-       * Current position of clockhand in our buffer pool
+       * Number of hash table shards
        */
-      FrameId clockHand;
+      static const std::uint32_t NUM_HASH_SHARDS = 16;
 
       /**
        * Number of frames in the buffer pool
@@ -163,9 +298,9 @@ namespace badgerdb {
       std::uint32_t numBufs;
 
       /**
-       * Hash table mapping (File, page) to frame
+       * Shards of the hash table mapping (File, page) to frame
        */
-      BufHashTbl *hashTable; // an array of hash buckets
+      BufHashShard *hashShards; // an array of hash table shards
 
       /**
        * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
@@ -178,12 +313,155 @@ namespace badgerdb {
       BufStats bufStats;
 
       /**
-       * Advance clock to next frame in the buffer pool
+       * Policy choosing the frames to evict
+       */
+      ReplacementPolicy *policy;
+
+      /**
+       * Engine doing the disk I/O of the buffer pool that can overlap: the
+       * reads of readPages(), the writes of flushFile() and the runs written
+       * by cleanFrames(). A single miss, read-ahead run, eviction, page
+       * allocation or disposal waits for its only I/O, so it does it on the
+       * calling thread instead.
+       */
+      IoEngine ioEngine;
+
+      /**
+       * Frames holding the pages of each file
+       */
+      std::unordered_map<const File*, std::vector<FrameId>> fileFrames;
+
+      /**
+       * Latch protecting fileFrames, taken after any frame or shard latch
+       */
+      std::mutex fileFramesLatch;
+
+      /**
+       * Background writer thread, if started
+       */
+      std::thread writerThread;
+
+      /**
+       * Latch protecting the state of the background writer
        */
-      void advanceClock();
+      std::mutex writerLatch;
 
       /**
-       * Allocate a free frame.
+       * Signalled to wake the background writer up early
+       */
+      std::condition_variable writerCondition;
+
+      /**
+       * Whether the background writer is running
+       */
+      std::atomic<bool> isWriterRunning;
+
+      /**
+       * Whether the background writer is to exit
+       */
+      bool isWriterStopping;
+
+      /**
+       * Share of the frames, taken from the next victims, that the background
+       * writer keeps clean
+       */
+      double writerCleanShare;
+
+      /**
+       * Loop of the background writer thread
+       */
+      void runBackgroundWriter();
+
+      /**
+       * Write back the dirty pages among the frames the replacement policy
+       * evicts next, the share writerCleanShare of the pool, so that the
+       * evictions do not have to. The pages are written in order of file and
+       * page number, each run of consecutive pages as one I/O, and stay in
+       * the buffer pool.
+       */
+      void cleanFrames();
+
+      /**
+       * Add a frame to the list of frames of the file of its page
+       *
+       * @param frameNo Frame number
+       */
+      void addFileFrame(FrameId frameNo);
+
+      /**
+       * Remove a frame from the list of frames of the file of its page
+       *
+       * @param frameNo Frame number
+       */
+      void removeFileFrame(FrameId frameNo);
+
+      /**
+       * Latch a frame for eviction if it is not pinned and no other thread
+       * has latched it
+       *
+       * @param frameNo Frame number
+       * @return        true if the frame has been latched
+       */
+      bool claimFrame(FrameId frameNo);
+
+      /**
+       * Evict the page in a frame latched by claimFrame(), writing it back if
+       * it is dirty. If the page has been pinned in the meantime, the frame
+       * is left as it is and unlatched.
+       *
+       * @param frameNo Frame number
+       * @return        true if the frame is free and still latched
+       */
+      bool evictFrame(FrameId frameNo);
+
+      /**
+       * Take the frame of a slot of a ring back for a new page. The frame is
+       * returned latched, as by allocBuf().
+       *
+       * @param ring    Buffer ring
+       * @param slot    Slot of the ring
+       * @param frame   Frame reference, frame ID of the frame returned via
+       *                this variable
+       * @return        false if the frame cannot be reused, since it is in
+       *                use or holds a page loaded by someone else
+       */
+      bool reuseRingFrame(BufferRing *ring, std::size_t slot, FrameId &frame);
+
+      /**
+       * Whether a miss of a scan reading through a ring is on the page
+       * following the last page loaded into the ring
+       *
+       * @param ring    Buffer ring
+       * @param file    File object
+       * @param pageNo  Page number in the file
+       */
+      bool isSequentialMiss(const BufferRing *ring, const File *file, const PageId pageNo);
+
+      /**
+       * Read a page missed by a sequential scan together with the pages
+       * following it that are not in the buffer pool, into the next frames
+       * of the scan's ring. Only the requested page is pinned.
+       *
+       * @param file    File object
+       * @param pageNo  Page number in the file to be read
+       * @param page    Reference to page pointer, the requested page is
+       *                returned via this variable
+       * @param ring    Buffer ring of the scan
+       */
+      void readAhead(File *file, const PageId pageNo, Page *&page, BufferRing *ring);
+
+      /**
+       * Get the hash table shard holding (file, pageNo)
+       *
+       * @param file   	File object
+       * @param pageNo  Page number in the file
+       * @return  			Hash table shard.
+       */
+      BufHashShard& getShard(const File *file, const PageId pageNo);
+
+      /**
+       * Allocate a free frame. The frame is returned latched, and the caller
+       * must release its latch.
        *
        * @param frame   	Frame reference, frame ID of allocated frame returned
        *        via this variable
@@ -200,8 +478,13 @@ namespace badgerdb {
 
       /**
        * Constructor of BufMgr class
+       *
+       * @param bufs    Number of frames in the buffer pool
+       * @param policy  Replacement policy for bufs frames, which the buffer
+       *                manager takes ownership of. If NULL, clock replacement
+       *                is used.
        */
-      BufMgr(std::uint32_t bufs);
+      BufMgr(std::uint32_t bufs, ReplacementPolicy *policy = NULL);
 
       /**
        * Destructor of BufMgr class
@@ -218,8 +501,12 @@ namespace badgerdb {
        * @param PageNo  Page number in the file to be read
        * @param page  	Reference to page pointer. Used to fetch the Page object in
        *                which requested page from file is read in.
+       * @param ring    Buffer ring of a sequential scan to read the page into,
+       *                or NULL to take a frame from the whole pool. The ring
+       *                may read pages ahead of the scan.
        */
-      void readPage(File *file, const PageId PageNo, Page *&page);
+      void readPage(File *file, const PageId PageNo, Page *&page,
+          BufferRing *ring = NULL);
 
       /**
        * Unpin a page from memory since it is no longer required for it to remain
@@ -232,6 +519,20 @@ namespace badgerdb {
        */
       void unPinPage(File *file, const PageId PageNo, const bool dirty);
 
+      /**
+       * Reads several pages of a file into the buffer pool and pins them, as
+       * readPage() does for each of them. The pages missing from the pool
+       * are read by the I/O engine at the same time, and the call returns
+       * when all of them are in.
+       *
+       * @param file    	File object
+       * @param pageNos   Numbers of the pages to read
+       * @param pages     Pointers to the pages, in the order of pageNos, are
+       *                  returned via this vector
+       */
+      void readPages(File *file, const std::vector<PageId> &pageNos,
+          std::vector<Page*> &pages);
+
       /**
        * Allocates a new, empty page in the file and returns the Page object.
        * The newly allocated page is also assigned a frame in the buffer pool.
@@ -250,6 +551,11 @@ namespace badgerdb {
        * before this function can be successfully called.
        * Otherwise Error returned.
        *
+       * Only the pages read or allocated through this File object are flushed,
+       * in time proportional to their number. Pages are kept apart by File
+       * object like in the hash table, so a File object must be flushed
+       * before it is destroyed.
+       *
        * @param file   	File object
        * @throws  PagePinnedException If any page of the file is pinned in the
        *          buffer pool
@@ -268,6 +574,31 @@ namespace badgerdb {
        */
       void disposePage(File *file, const PageId PageNo);
 
+      /**
+       * Default share of the frames the background writer keeps clean
+       */
+      static constexpr double DEFAULT_CLEAN_SHARE = 0.25;
+
+      /**
+       * Time between two rounds of the background writer, in milliseconds
+       */
+      static const int WRITER_INTERVAL_MS = 10;
+
+      /**
+       * Start a thread writing dirty pages back in the background. It wakes
+       * up periodically, and whenever a dirty page has been evicted, and
+       * cleans the frames the replacement policy evicts next, up to the given
+       * share of the pool. The pages stay in the buffer pool.
+       *
+       * @param cleanShare  Share of the frames to keep clean ahead of eviction
+       */
+      void startBackgroundWriter(double cleanShare = DEFAULT_CLEAN_SHARE);
+
+      /**
+       * Stop the background writer thread, if it is running
+       */
+      void stopBackgroundWriter();
+
       /**
        * Print member variable values.
        */
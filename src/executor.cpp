@@ -7,17 +7,22 @@
 #include "executor.h"
 #include "buffer.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <functional>
 #include <string>
+#include <thread>
+#include <sstream>
 #include <iostream>
 #include <ctime>
-#include <map>
 
 #include "storage.h"
 #include "file_iterator.h"
 #include "page_iterator.h"
 #include "exceptions/invalid_page_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_not_found_exception.h"
 
 namespace badgerdb {
   void printVectorInt(vector<int> vec) {
@@ -27,54 +32,672 @@ namespace badgerdb {
     std::cout << endl;
   }
 
-  vector<string> split(const string tuple, const string delimiters) {
-    vector<string> tokens;
-    string::size_type lastPos = tuple.find_first_not_of(delimiters, 0);
-    string::size_type pos = tuple.find_first_of(delimiters, lastPos);
-    while (string::npos != pos || string::npos != lastPos) {
-      tokens.push_back(tuple.substr(lastPos, pos - lastPos));
-      lastPos = tuple.find_first_not_of(delimiters, pos);
-      pos = tuple.find_first_of(delimiters, lastPos);
+  /*
+   * Compose the join key of a tuple from the values of its join attributes.
+   */
+  string getJoinKey(const TupleView &tuple, const vector<int> &joinAttrsID) {
+    string key = "";
+    for (unsigned int i = 0; i < joinAttrsID.size(); i++) {
+      tuple.appendKey(joinAttrsID[i], key);
     }
-    return tokens;
+    return key;
+  }
+
+  /*
+   * Append a record to the page of the file that is pinned in the buffer pool.
+   * If no page is pinned yet (pageNo is Page::INVALID_NUMBER) or the pinned
+   * page is full, the page is unpinned and a new one is allocated.
+   * @return If a new page was allocated, return true
+   */
+  bool appendRecord(BufMgr *bufMgr, File *file, const RecordView &record,
+      PageId &pageNo, Page *&page) {
+    bool isNewPage = false;
+    if (pageNo == Page::INVALID_NUMBER || page->hasSpaceForRecord(record) == false) {
+      if (pageNo != Page::INVALID_NUMBER) {
+        bufMgr->unPinPage(file, pageNo, true);
+      }
+      bufMgr->allocPage(file, pageNo, page);
+      isNewPage = true;
+    }
+    page->insertRecord(record);
+    return isNewPage;
+  }
+
+  /*
+   * Count the pages of a file. Only the page headers are read.
+   */
+  int countPages(File &file) {
+    int numPages = 0;
+    for (FileIterator itFile = file.begin(); itFile != file.end(); itFile++) {
+      numPages++;
+    }
+    return numPages;
+  }
+
+  /*
+   * Create a temporary file, replacing any file left behind by an earlier run.
+   */
+  File* createTempFile(const string &filename) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+    return new File(File::create(filename));
+  }
+
+  /*
+   * Flush the pages of a temporary file out of the buffer pool, then close
+   * and delete it.
+   */
+  void removeTempFile(BufMgr *bufMgr, File *file) {
+    string filename = file->filename();
+    bufMgr->flushFile(file);
+    delete file;
+    File::remove(filename);
   }
 
   void TableScanner::print() const {
     std::cout << "scanning file - " << this->tableFile.filename() << "\n";
     try {
-      File *file = &(this->tableFile);
-      FileIterator itFile = file->begin();
-      Page page;
-      PageIterator itPage;
-      string record;
-
-      while (itFile != file->end()) {
-        page = *(itFile);
-        itPage = page.begin();
-        while (itPage != page.end()) {
-          record = *(itPage);
-          std::cout << "record(pageNo: " << page.page_number() << ") - '" << record
-              << "'\n";
-          itPage++;
-        }
-        itFile++;
+      TableScanOperator scan(this->tableFile, this->tableSchema, this->bufMgr);
+      TupleLayout tupleLayout(this->tableSchema);
+      RecordView record;
+
+      scan.open();
+      while (scan.next(record)) {
+        std::cout << "record(pageNo: " << scan.getPageNumber() << ") - '"
+            << TupleView(tupleLayout, record).toString() << "'\n";
       }
+      scan.close();
+      this->bufMgr->flushFile(&(this->tableFile));
 
     } catch (const InvalidPageException &e) {
       std::cout << "throws invalid page exception" << "\n";
     }
   }
 
+  bool Operator::nextBatch(TupleBatch &batch) {
+    batch.clear();
+    RecordView tuple;
+    while (batch.isFull() == false && this->next(tuple)) {
+      batch.append(tuple);
+    }
+    return batch.getNumRows() > 0;
+  }
+
+  TableScanOperator::TableScanOperator(File &tableFile, const TableSchema &tableSchema,
+      BufMgr *bufMgr, bool isRingUsed) :
+      tableFile(tableFile), tableSchema(tableSchema), bufMgr(bufMgr), isRingUsed(isRingUsed),
+          pageNo(Page::INVALID_NUMBER), page(NULL), numReadPages(0) {
+    // nothing
+  }
+
+  int TableScanOperator::estimateNumPages() const {
+    return countPages(this->tableFile);
+  }
+
+  void TableScanOperator::open() {
+    this->close();
+    this->itFile = this->tableFile.begin();
+  }
+
+  bool TableScanOperator::readNextPage() {
+    if (this->pageNo != Page::INVALID_NUMBER) {
+      this->close();
+      this->itFile++;
+    }
+    if (this->itFile == this->tableFile.end()) {
+      return false;
+    }
+    this->pageNo = this->itFile.page_number();
+    this->bufMgr->readPage(&(this->tableFile), this->pageNo, this->page,
+        this->isRingUsed ? &(this->ring) : NULL);
+    this->numReadPages++;
+    this->itPage = this->page->begin();
+    return true;
+  }
+
+  bool TableScanOperator::next(RecordView &tuple) {
+    while (this->pageNo == Page::INVALID_NUMBER || this->itPage == this->page->end()) {
+      if (this->readNextPage() == false) {
+        return false;
+      }
+    }
+    tuple = this->itPage.getRecordView();
+    this->itPage++;
+    return true;
+  }
+
+  bool TableScanOperator::nextBatch(TupleBatch &batch) {
+    batch.clear();
+    while (batch.isFull() == false) {
+      if (this->pageNo == Page::INVALID_NUMBER || this->itPage == this->page->end()) {
+        if (this->readNextPage() == false) {
+          break;
+        }
+        continue;
+      }
+      batch.append(this->itPage.getRecordView());
+      this->itPage++;
+    }
+    return batch.getNumRows() > 0;
+  }
+
+  void TableScanOperator::close() {
+    if (this->pageNo != Page::INVALID_NUMBER) {
+      this->bufMgr->unPinPage(&(this->tableFile), this->pageNo, false);
+      this->pageNo = Page::INVALID_NUMBER;
+    }
+  }
+
+  void FileSink::write(Operator &input) {
+    PageId pageNo = Page::INVALID_NUMBER;
+    Page *page = NULL;
+    TupleLayout tupleLayout(input.getSchema());
+    TupleBatch batch(tupleLayout);
+    input.open();
+    while (input.nextBatch(batch)) {
+      for (int i = 0; i < batch.getNumRows(); i++) {
+        if (appendRecord(this->bufMgr, &(this->file), batch.getRow(i), pageNo, page)) {
+          this->numPages++;
+        }
+        this->numTuples++;
+      }
+    }
+    input.close();
+    if (pageNo != Page::INVALID_NUMBER) {
+      this->bufMgr->unPinPage(&(this->file), pageNo, true);
+    }
+    this->bufMgr->flushFile(&(this->file));
+  }
+
+
+  RunReader::RunReader(BufMgr *bufMgr, File *file, const vector<PageId> &pages) :
+      bufMgr(bufMgr), file(file), pages(pages), nextPageIndex(0), pageNo(
+          Page::INVALID_NUMBER), page(NULL), numReadPages(0) {
+    // nothing
+  }
+
+  bool RunReader::next(RecordView &record) {
+    while (this->pageNo == Page::INVALID_NUMBER || this->itPage == this->page->end()) {
+      this->close();
+      if (this->nextPageIndex >= this->pages.size()) {
+        return false;
+      }
+      this->pageNo = this->pages[this->nextPageIndex++];
+      this->bufMgr->readPage(this->file, this->pageNo, this->page);
+      this->numReadPages++;
+      this->itPage = this->page->begin();
+    }
+    record = this->itPage.getRecordView();
+    this->itPage++;
+    return true;
+  }
+
+  void RunReader::close() {
+    if (this->pageNo != Page::INVALID_NUMBER) {
+      this->bufMgr->unPinPage(this->file, this->pageNo, false);
+      this->pageNo = Page::INVALID_NUMBER;
+    }
+  }
+
+  LoserTree::LoserTree(const vector<string> &keys, const vector<bool> &isExhausted) :
+      keys(keys), isExhausted(isExhausted), numRuns(keys.size()), tree(keys.size(), 0) {
+    this->winner = this->numRuns > 1 ? this->build(1) : 0;
+  }
+
+  bool LoserTree::isLess(int a, int b) const {
+    if (this->isExhausted[a]) {
+      return false;
+    }
+    if (this->isExhausted[b]) {
+      return true;
+    }
+    int result = this->keys[a].compare(this->keys[b]);
+    return result < 0 || (result == 0 && a < b);
+  }
+
+  int LoserTree::build(int node) {
+    if (node >= this->numRuns) {
+      return node - this->numRuns;
+    }
+    int left = this->build(2 * node);
+    int right = this->build(2 * node + 1);
+    if (this->isLess(left, right)) {
+      this->tree[node] = right;
+      return left;
+    }
+    this->tree[node] = left;
+    return right;
+  }
+
+  void LoserTree::replay() {
+    int candidate = this->winner;
+    for (int node = (candidate + this->numRuns) / 2; node >= 1; node /= 2) {
+      if (this->isLess(this->tree[node], candidate)) {
+        std::swap(this->tree[node], candidate);
+      }
+    }
+    this->winner = candidate;
+  }
+
+  /*
+   * Order of (key, record) pairs in a run, only the keys are compared.
+   */
+  bool isSortKeyLess(const pair<string, string> &a, const pair<string, string> &b) {
+    return a.first < b.first;
+  }
+
+  string ExternalSort::getSortKey(const RecordView &record) const {
+    return getJoinKey(TupleView(this->tupleLayout, record), this->sortAttrsID);
+  }
+
+  ExternalSort::SortRun ExternalSort::createRun(const File &outputFile) {
+    stringstream ss;
+    ss << outputFile.filename() << ".run." << this->numTempFiles++;
+    SortRun run;
+    run.file = createTempFile(ss.str());
+    return run;
+  }
+
+  void ExternalSort::writeRun(vector<pair<string, string>> &tuples, File *file,
+      vector<PageId> &pages) {
+    std::stable_sort(tuples.begin(), tuples.end(), isSortKeyLess);
+    PageId pageNo = Page::INVALID_NUMBER;
+    Page *page = NULL;
+    for (unsigned int i = 0; i < tuples.size(); i++) {
+      if (appendRecord(this->bufMgr, file, tuples[i].second, pageNo, page)) {
+        pages.push_back(pageNo);
+      }
+    }
+    if (pageNo != Page::INVALID_NUMBER) {
+      this->bufMgr->unPinPage(file, pageNo, true);
+    }
+    this->bufMgr->flushFile(file);
+    this->numIOs += pages.size();
+  }
+
+  void ExternalSort::mergeRuns(const vector<SortRun> &runs, File *file,
+      vector<PageId> &pages) {
+    int numMergedRuns = runs.size();
+    vector<RunReader> readers;
+    vector<RecordView> records(numMergedRuns);
+    vector<string> keys(numMergedRuns);
+    vector<bool> isExhausted(numMergedRuns, false);
+    for (int i = 0; i < numMergedRuns; i++) {
+      readers.push_back(RunReader(this->bufMgr, runs[i].file, runs[i].pages));
+      isExhausted[i] = readers[i].next(records[i]) == false;
+      if (isExhausted[i] == false) {
+        keys[i] = this->getSortKey(records[i]);
+      }
+    }
+
+    LoserTree loserTree(keys, isExhausted);
+    PageId pageNo = Page::INVALID_NUMBER;
+    Page *page = NULL;
+    while (isExhausted[loserTree.getWinner()] == false) {
+      int winner = loserTree.getWinner();
+      if (appendRecord(this->bufMgr, file, records[winner], pageNo, page)) {
+        pages.push_back(pageNo);
+      }
+      isExhausted[winner] = readers[winner].next(records[winner]) == false;
+      if (isExhausted[winner] == false) {
+        keys[winner] = this->getSortKey(records[winner]);
+      }
+      loserTree.replay();
+    }
+    if (pageNo != Page::INVALID_NUMBER) {
+      this->bufMgr->unPinPage(file, pageNo, true);
+    }
+    this->bufMgr->flushFile(file);
+    this->numIOs += pages.size();
+
+    for (int i = 0; i < numMergedRuns; i++) {
+      readers[i].close();
+      this->numIOs += readers[i].getNumReadPages();
+    }
+  }
+
+  vector<PageId> ExternalSort::sort(Operator &input, int numAvailableBufPages,
+      File &outputFile) {
+    this->numRuns = 0;
+    this->numPasses = 0;
+    this->numIOs = 0;
+
+    // a run fills all buffer pages but the one used to read the input
+    int availablePages = max(numAvailableBufPages, 3);
+    std::size_t runCapacity = (availablePages - 1) * Page::DATA_SIZE;
+    unsigned int fanIn = availablePages - 1;
+
+    // run generation
+    vector<SortRun> runs;
+    vector<pair<string, string>> tuples;
+    std::size_t runSize = 0;
+    RecordView record;
+    input.open();
+    while (input.next(record)) {
+      std::size_t recordSize = record.length + sizeof(PageSlot);
+      if (runSize + recordSize > runCapacity && tuples.empty() == false) {
+        runs.push_back(this->createRun(outputFile));
+        this->writeRun(tuples, runs.back().file, runs.back().pages);
+        tuples.clear();
+        runSize = 0;
+      }
+      tuples.push_back(pair<string, string>(this->getSortKey(record), record.str()));
+      runSize += recordSize;
+    }
+    input.close();
+    this->numPasses++;
+
+    vector<PageId> outputPages;
+    if (runs.empty()) {
+      // everything fits in memory, the only run is the output
+      this->numRuns = tuples.empty() ? 0 : 1;
+      this->writeRun(tuples, &outputFile, outputPages);
+      return outputPages;
+    }
+    runs.push_back(this->createRun(outputFile));
+    this->writeRun(tuples, runs.back().file, runs.back().pages);
+    tuples.clear();
+    this->numRuns = runs.size();
+
+    // merge passes, until the runs left can be merged at once
+    while (runs.size() > fanIn) {
+      vector<SortRun> mergedRuns;
+      for (unsigned int i = 0; i < runs.size(); i += fanIn) {
+        vector<SortRun> group(runs.begin() + i,
+            runs.begin() + min((std::size_t) (i + fanIn), runs.size()));
+        if (group.size() == 1) {
+          mergedRuns.push_back(group[0]);
+          continue;
+        }
+        mergedRuns.push_back(this->createRun(outputFile));
+        this->mergeRuns(group, mergedRuns.back().file, mergedRuns.back().pages);
+        for (unsigned int j = 0; j < group.size(); j++) {
+          removeTempFile(this->bufMgr, group[j].file);
+        }
+      }
+      runs = mergedRuns;
+      this->numPasses++;
+    }
+
+    // final merge into the output file
+    this->mergeRuns(runs, &outputFile, outputPages);
+    for (unsigned int i = 0; i < runs.size(); i++) {
+      removeTempFile(this->bufMgr, runs[i].file);
+    }
+    this->numPasses++;
+    return outputPages;
+  }
+
+  const uint32_t JoinHashTable::NO_ENTRY;
+
+  JoinHashTable::JoinHashTable(std::size_t budget) :
+      budget(budget), slots(16), numKeys(0) {
+    for (unsigned int i = 0; i < this->slots.size(); i++) {
+      this->slots[i].head = NO_ENTRY;
+    }
+  }
+
+  void JoinHashTable::clear() {
+    this->keyData.clear();
+    this->tupleData.clear();
+    this->entries.clear();
+    this->slots.assign(16, Slot());
+    for (unsigned int i = 0; i < this->slots.size(); i++) {
+      this->slots[i].head = NO_ENTRY;
+    }
+    this->numKeys = 0;
+  }
+
+  std::size_t JoinHashTable::hashKey(const KeyView &key) {
+    // FNV-1a, then the finalizer of MurmurHash3 so that the low bits, which
+    // pick the slot and the radix partition, depend on all the bytes
+    uint64_t value = 0xcbf29ce484222325ULL;
+    for (std::size_t i = 0; i < key.length; i++) {
+      value = (value ^ (unsigned char) key.data[i]) * 0x100000001b3ULL;
+    }
+    value = (value ^ (value >> 33)) * 0xff51afd7ed558ccdULL;
+    value = (value ^ (value >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return value ^ (value >> 33);
+  }
+
+  uint32_t JoinHashTable::findSlot(const KeyView &key, std::size_t hash) const {
+    uint32_t mask = this->slots.size() - 1;
+    uint32_t slot = hash & mask;
+    while (this->slots[slot].head != NO_ENTRY) {
+      const Entry &entry = this->entries[this->slots[slot].head];
+      if (entry.hash == hash && entry.keyLength == key.length
+          && memcmp(this->keyData.data() + entry.keyOffset, key.data, key.length) == 0) {
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  void JoinHashTable::grow() {
+    vector<Slot> oldSlots(this->slots.size() * 2);
+    oldSlots.swap(this->slots);
+    uint32_t mask = this->slots.size() - 1;
+    for (unsigned int i = 0; i < this->slots.size(); i++) {
+      this->slots[i].head = NO_ENTRY;
+    }
+    for (unsigned int i = 0; i < oldSlots.size(); i++) {
+      if (oldSlots[i].head == NO_ENTRY) {
+        continue;
+      }
+      uint32_t slot = this->entries[oldSlots[i].head].hash & mask;
+      while (this->slots[slot].head != NO_ENTRY) {
+        slot = (slot + 1) & mask;
+      }
+      this->slots[slot] = oldSlots[i];
+    }
+  }
+
+  void JoinHashTable::insert(const KeyView &key, std::size_t hash, const RecordView &tuple) {
+    uint32_t slot = this->findSlot(key, hash);
+    Entry entry;
+    entry.hash = hash;
+    entry.tupleOffset = this->tupleData.size();
+    entry.tupleLength = tuple.length;
+    entry.next = NO_ENTRY;
+    this->tupleData.append(tuple.data, tuple.length);
+    uint32_t entryNo = this->entries.size();
+    if (this->slots[slot].head != NO_ENTRY) {
+      // chain the tuple after the last one of its key, sharing the key bytes
+      const Entry &head = this->entries[this->slots[slot].head];
+      entry.keyOffset = head.keyOffset;
+      entry.keyLength = head.keyLength;
+      this->entries.push_back(entry);
+      this->entries[this->slots[slot].tail].next = entryNo;
+      this->slots[slot].tail = entryNo;
+      return;
+    }
+    entry.keyOffset = this->keyData.size();
+    entry.keyLength = key.length;
+    this->keyData.append(key.data, key.length);
+    this->entries.push_back(entry);
+    this->slots[slot].head = entryNo;
+    this->slots[slot].tail = entryNo;
+    this->numKeys++;
+    if (2 * this->numKeys > this->slots.size()) {
+      this->grow();
+    }
+  }
+
+  JoinHashTable::MatchIterator JoinHashTable::find(const KeyView &key, std::size_t hash) const {
+    return MatchIterator(this, this->slots[this->findSlot(key, hash)].head);
+  }
+
+  const uint32_t RadixHashTable::EMPTY_SLOT;
+
+  void RadixHashTable::clear() {
+    this->keyData.clear();
+    this->tupleData.clear();
+    this->entries.clear();
+    this->passBits.clear();
+    this->numBits = 0;
+    this->partitionBounds.clear();
+    this->slots.clear();
+    this->slotOffsets.clear();
+    this->slotMasks.clear();
+  }
+
+  void RadixHashTable::insert(const KeyView &key, const RecordView &tuple) {
+    Entry entry;
+    entry.hash = JoinHashTable::hashKey(key);
+    entry.keyOffset = this->keyData.size();
+    entry.keyLength = key.length;
+    entry.tupleOffset = this->tupleData.size();
+    entry.tupleLength = tuple.length;
+    this->keyData.append(key.data, key.length);
+    this->tupleData.append(tuple.data, tuple.length);
+    this->entries.push_back(entry);
+  }
+
+  void RadixHashTable::build() {
+    // as many radix bits as needed for a partition to fit in its size
+    std::size_t numBytes = this->entries.size() * sizeof(Entry);
+    this->numBits = 0;
+    while ((numBytes >> this->numBits) > this->partitionSize
+        && this->numBits < 2 * MAX_BITS_PER_PASS) {
+      this->numBits++;
+    }
+    this->passBits.clear();
+    if (this->numBits > MAX_BITS_PER_PASS) {
+      this->passBits.push_back((this->numBits + 1) / 2);
+      this->passBits.push_back(this->numBits / 2);
+    } else if (this->numBits > 0) {
+      this->passBits.push_back(this->numBits);
+    }
+
+    // each pass splits every partition of the pass before on the next bits,
+    // counting the entries of each new partition first, then copying them
+    this->partitionBounds.clear();
+    this->partitionBounds.push_back(0);
+    this->partitionBounds.push_back(this->entries.size());
+    vector<Entry> buffer(this->entries.size());
+    int shift = 0;
+    for (unsigned int i = 0; i < this->passBits.size(); i++) {
+      uint32_t numFanOut = 1u << this->passBits[i];
+      uint32_t mask = numFanOut - 1;
+      vector<uint32_t> bounds;
+      bounds.push_back(0);
+      vector<uint32_t> offsets(numFanOut);
+      for (unsigned int j = 0; j + 1 < this->partitionBounds.size(); j++) {
+        uint32_t first = this->partitionBounds[j];
+        uint32_t last = this->partitionBounds[j + 1];
+        offsets.assign(numFanOut, 0);
+        for (uint32_t k = first; k < last; k++) {
+          offsets[(this->entries[k].hash >> shift) & mask]++;
+        }
+        uint32_t offset = first;
+        for (uint32_t k = 0; k < numFanOut; k++) {
+          uint32_t count = offsets[k];
+          offsets[k] = offset;
+          offset += count;
+          bounds.push_back(offset);
+        }
+        for (uint32_t k = first; k < last; k++) {
+          buffer[offsets[(this->entries[k].hash >> shift) & mask]++] = this->entries[k];
+        }
+      }
+      this->entries.swap(buffer);
+      this->partitionBounds.swap(bounds);
+      shift += this->passBits[i];
+    }
+
+    // a table of at least twice as many slots as entries per partition
+    this->slots.clear();
+    this->slotOffsets.clear();
+    this->slotMasks.clear();
+    for (unsigned int i = 0; i + 1 < this->partitionBounds.size(); i++) {
+      uint32_t first = this->partitionBounds[i];
+      uint32_t last = this->partitionBounds[i + 1];
+      uint32_t numSlots = 2;
+      while (numSlots < 2 * (last - first)) {
+        numSlots *= 2;
+      }
+      uint32_t slotOffset = this->slots.size();
+      this->slotOffsets.push_back(slotOffset);
+      this->slotMasks.push_back(numSlots - 1);
+      this->slots.resize(slotOffset + numSlots, EMPTY_SLOT);
+      for (uint32_t k = first; k < last; k++) {
+        uint32_t slot = (this->entries[k].hash >> this->numBits) & (numSlots - 1);
+        while (this->slots[slotOffset + slot] != EMPTY_SLOT) {
+          slot = (slot + 1) & (numSlots - 1);
+        }
+        this->slots[slotOffset + slot] = k;
+      }
+    }
+  }
+
+  void RadixHashTable::find(const KeyView &key, std::size_t hash,
+      vector<RecordView> &tuples) const {
+    uint32_t partition = this->getPartition(hash);
+    uint32_t slotOffset = this->slotOffsets[partition];
+    uint32_t mask = this->slotMasks[partition];
+    uint32_t slot = (hash >> this->numBits) & mask;
+    while (this->slots[slotOffset + slot] != EMPTY_SLOT) {
+      const Entry &entry = this->entries[this->slots[slotOffset + slot]];
+      if (entry.hash == hash && entry.keyLength == key.length
+          && memcmp(this->keyData.data() + entry.keyOffset, key.data, key.length) == 0) {
+        tuples.push_back(RecordView(this->tupleData.data() + entry.tupleOffset,
+            entry.tupleLength));
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  /*
+   * Number of join operators created, used to name their temporary files
+   */
+  std::atomic<int> numJoinOperators(0);
+
+  /*
+   * Prefix of the names of the temporary files of a new join operator
+   */
+  string createTempFilePrefix() {
+    stringstream ss;
+    ss << "join." << numJoinOperators++;
+    return ss.str();
+  }
+
   JoinOperator::JoinOperator(File &leftTableFile, File &rightTableFile,
       const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
+      const Catalog *catalog, BufMgr *bufMgr, bool isRightRescanned) :
+      leftScan(new TableScanOperator(leftTableFile, leftTableSchema, bufMgr)), rightScan(
+          new TableScanOperator(rightTableFile, rightTableSchema, bufMgr,
+              isRightRescanned == false)), leftInput(leftScan), rightInput(rightScan),
+          leftTableSchema(leftTableSchema), rightTableSchema(rightTableSchema),
+          resultTableSchema(createResultTableSchema(leftTableSchema, rightTableSchema)),
+          leftTupleLayout(leftTableSchema), rightTupleLayout(rightTableSchema),
+          resultTupleLayout(resultTableSchema), catalog(catalog), bufMgr(bufMgr),
+          numAvailableBufPages(DEFAULT_NUM_AVAILABLE_BUF_PAGES), tempFilePrefix(
+              createTempFilePrefix()), nextResultTuple(0), isComplete(false),
+          numResultTuples(0), numUsedBufPages(0), numIOs(0) {
+    // nothing
+  }
+
+  JoinOperator::JoinOperator(Operator &leftInput, Operator &rightInput,
       const Catalog *catalog, BufMgr *bufMgr) :
-      leftTableFile(leftTableFile), rightTableFile(rightTableFile), leftTableSchema(
-          leftTableSchema), rightTableSchema(rightTableSchema), resultTableSchema(
-          createResultTableSchema(leftTableSchema, rightTableSchema)), catalog(catalog), bufMgr(
-          bufMgr), isComplete(false) {
+      leftScan(NULL), rightScan(NULL), leftInput(&leftInput), rightInput(&rightInput),
+          leftTableSchema(leftInput.getSchema()), rightTableSchema(rightInput.getSchema()),
+          resultTableSchema(createResultTableSchema(leftTableSchema, rightTableSchema)),
+          leftTupleLayout(leftTableSchema), rightTupleLayout(rightTableSchema),
+          resultTupleLayout(resultTableSchema), catalog(catalog), bufMgr(bufMgr),
+          numAvailableBufPages(DEFAULT_NUM_AVAILABLE_BUF_PAGES), tempFilePrefix(
+              createTempFilePrefix()), nextResultTuple(0), isComplete(false),
+          numResultTuples(0), numUsedBufPages(0), numIOs(0) {
     // nothing
   }
 
+  JoinOperator::~JoinOperator() {
+    delete this->leftScan;
+    delete this->rightScan;
+  }
+
   TableSchema JoinOperator::createResultTableSchema(const TableSchema &leftTableSchema,
       const TableSchema &rightTableSchema) {
     vector<Attribute> attrs;
@@ -109,347 +732,709 @@ namespace badgerdb {
     return TableSchema("TEMP_TABLE", attrs, true);
   }
 
+  void JoinOperator::getJoinAttrsID(vector<int> &joinAttrsIDLeft,
+      vector<int> &joinAttrsIDRight) const {
+    int leftTableAttrsNum = this->leftTableSchema.getAttrCount();
+    int rightTableAttrsNum = this->rightTableSchema.getAttrCount();
+    for (int i = 0; i < leftTableAttrsNum; i++) {
+      string leftAttrName = this->leftTableSchema.getAttrName(i);
+      for (int j = 0; j < rightTableAttrsNum; j++) {
+        if (leftAttrName == this->rightTableSchema.getAttrName(j)) {
+          joinAttrsIDLeft.push_back(i);
+          joinAttrsIDRight.push_back(j);
+        }
+      }
+    }
+  }
+
+  string JoinOperator::joinTuples(const RecordView &leftRecord,
+      const RecordView &rightRecord) const {
+    TupleView leftTuple(this->leftTupleLayout, leftRecord);
+    TupleView rightTuple(this->rightTupleLayout, rightRecord);
+    TupleBuilder tupleBuilder(this->resultTupleLayout);
+    int resultAttrID = 0;
+    // add the left part
+    for (int i = 0; i < this->leftTupleLayout.getAttrCount(); i++) {
+      tupleBuilder.copy(resultAttrID++, leftTuple, i);
+    }
+
+    // add the right part, leaving out the join attributes
+    unsigned int joinAttrIndex = 0;
+    for (int i = 0; i < this->rightTupleLayout.getAttrCount(); i++) {
+      if (joinAttrIndex < this->joinAttrsIDRight.size()
+          && this->joinAttrsIDRight[joinAttrIndex] == i) {
+        joinAttrIndex++;
+        continue;
+      }
+      tupleBuilder.copy(resultAttrID++, rightTuple, i);
+    }
+    return tupleBuilder.build();
+  }
+
+  void JoinOperator::probe(const JoinHashTable &hashTable, const RecordView &record,
+      const vector<int> &probeAttrsID, bool isBuildLeft) {
+    const TupleLayout &probeTupleLayout =
+        isBuildLeft ? this->rightTupleLayout : this->leftTupleLayout;
+    JoinHashTable::MatchIterator it = hashTable.find(
+        getJoinKey(TupleView(probeTupleLayout, record), probeAttrsID));
+    for (; it != hashTable.end(); ++it) {
+      this->resultTuples.push_back(isBuildLeft ?
+          this->joinTuples(*it, record) : this->joinTuples(record, *it));
+    }
+  }
+
+  void JoinOperator::probe(const JoinHashTable &hashTable, TupleBatch &batch,
+      const vector<int> &probeAttrsID, bool isBuildLeft) {
+    // hash all the keys, then look them up, keeping the tuples with a match
+    // selected
+    batch.getKeys(probeAttrsID, this->batchKeyData, this->batchKeyOffsets);
+    vector<uint16_t> &selection = batch.getSelection();
+    this->batchHashes.resize(selection.size());
+    for (unsigned int i = 0; i < selection.size(); i++) {
+      this->batchHashes[i] = JoinHashTable::hashKey(this->getBatchKey(i));
+    }
+    this->batchMatches.clear();
+    unsigned int numMatched = 0;
+    for (unsigned int i = 0; i < selection.size(); i++) {
+      JoinHashTable::MatchIterator it = hashTable.find(this->getBatchKey(i),
+          this->batchHashes[i]);
+      if (it != hashTable.end()) {
+        selection[numMatched++] = selection[i];
+        this->batchMatches.push_back(it);
+      }
+    }
+    selection.resize(numMatched);
+
+    // then join the tuples left
+    for (unsigned int i = 0; i < numMatched; i++) {
+      RecordView record = batch.getRow(selection[i]);
+      for (JoinHashTable::MatchIterator it = this->batchMatches[i]; it != hashTable.end();
+          ++it) {
+        this->resultTuples.push_back(isBuildLeft ?
+            this->joinTuples(*it, record) : this->joinTuples(record, *it));
+      }
+    }
+  }
+
   void JoinOperator::printRunningStats() const {
     cout << "# Result Tuples: " << this->numResultTuples << endl;
     cout << "# Used Buffer Pages: " << this->numUsedBufPages << endl;
     cout << "# I/Os: " << this->numIOs << endl;
   }
 
-  bool OnePassJoinOperator::execute(int numAvailableBufPages, File &resultFile) {
-    std::cout << "... executing one-pass join" << "\n";
-    if (this->isComplete)
-      return true;
+  int JoinOperator::estimateNumPages() const {
+    int numLeftPages = this->leftInput->estimateNumPages();
+    int numRightPages = this->rightInput->estimateNumPages();
+    if (numLeftPages < 0 || numRightPages < 0) {
+      return -1;
+    }
+    return numLeftPages + numRightPages;
+  }
 
+  void JoinOperator::open() {
     this->resultTableSchema.print();
 
     this->numResultTuples = 0;
     this->numUsedBufPages = 0;
     this->numIOs = 0;
+    this->resultTuples.clear();
+    this->nextResultTuple = 0;
 
-    // result output
-    File *resultFilePointer = &resultFile;
-    PageId resultPageNo;
-    Page *resultPage;
-
-    // hash structure
-    vector<string> joinAttrs;
-    vector<int> joinAttrsIDLeft;
-    vector<int> joinAttrsIDRight;
-    vector<int> joinAttrsIDResult;
-    map<string, vector<string>> bufferMap;
-
-    // left table - 500; right table - 100
-    File *leftFile = &(this->leftTableFile);
-    File *rightFile = &(this->rightTableFile);
-    FileIterator itRightFile = rightFile->begin();
-    FileIterator itLeftFile = leftFile->begin();
-
-    // confirm the attributes' names and ids used for one-pass join
-    int leftTableAttrsNum = this->leftTableSchema.getAttrCount();
-    int rightTableAttrsNum = this->rightTableSchema.getAttrCount();
-    int resultTableAttrsNum = this->resultTableSchema.getAttrCount();
-    for (int i = 0; i < leftTableAttrsNum; i++) {
-      string leftAttrName = this->leftTableSchema.getAttrName(i);
-      for (int j = 0; j < rightTableAttrsNum; j++) {
-        string rightAttrName = this->rightTableSchema.getAttrName(j);
-        if (leftAttrName == rightAttrName) {
-          joinAttrs.push_back(leftAttrName);
-          joinAttrsIDLeft.push_back(i);
-          joinAttrsIDRight.push_back(j);
-//          std::cout << "join attribute: " << leftAttrName << endl;
-//          std::cout << "id in left: " << i << endl;
-//          std::cout << "id in right: " << j << endl;
-        }
+    this->joinAttrsIDLeft.clear();
+    this->joinAttrsIDRight.clear();
+    this->getJoinAttrsID(this->joinAttrsIDLeft, this->joinAttrsIDRight);
+  }
+
+  bool JoinOperator::next(RecordView &tuple) {
+    while (this->nextResultTuple >= this->resultTuples.size()) {
+      this->resultTuples.clear();
+      this->nextResultTuple = 0;
+      if (this->fill() == false) {
+        return false;
       }
     }
-    for (int i = 0; i < resultTableAttrsNum; i++) {
-      string resultAttrName = this->resultTableSchema.getAttrName(i);
-      for (unsigned int j = 0; j < joinAttrs.size(); j++) {
-        string joinAttrName = joinAttrs[j];
-        if (joinAttrName == resultAttrName) {
-          joinAttrsIDResult.push_back(i);
+    tuple = RecordView(this->resultTuples[this->nextResultTuple++]);
+    this->numResultTuples++;
+    return true;
+  }
+
+  bool JoinOperator::nextBatch(TupleBatch &batch) {
+    batch.clear();
+    while (batch.isFull() == false) {
+      if (this->nextResultTuple >= this->resultTuples.size()) {
+        this->resultTuples.clear();
+        this->nextResultTuple = 0;
+        if (this->fill() == false) {
+          break;
         }
+        continue;
       }
+      batch.append(this->resultTuples[this->nextResultTuple++]);
+      this->numResultTuples++;
     }
-//    printVectorInt(joinAttrsIDLeft);
-//    printVectorInt(joinAttrsIDRight);
-//    printVectorInt(joinAttrsIDResult);
-
-// build stage
-    while (itLeftFile != leftFile->end()) {
-      Page page = *(itLeftFile);
-      PageIterator itPage = page.begin();
-      while (itPage != page.end()) {
-        string record = *(itPage);
-        std::cout << "record(pageNo: " << page.page_number() << ") - '" << record
-            << "'\n";
-        vector<string> attrs = split(record, "\t");
-        string key = "";
-        for (unsigned int i = 0; i < joinAttrsIDLeft.size(); i++) {
-          /*
-           * about the 'attrs[joinAttrsIDLeft[i] + 1]'.
-           *   this is according to the format of tuples stored in a Page,
-           *   which is like "table_name \t attr1 \t attr2 \t ... "
-           */
-          key = key + attrs[joinAttrsIDLeft[i] + 1];
-        }
-        if (bufferMap.count(key) > 0) {
-          bufferMap.at(key).push_back(record);
+    return batch.getNumRows() > 0;
+  }
+
+  void JoinOperator::close() {
+    this->resultTuples.clear();
+    this->nextResultTuple = 0;
+    this->leftInput->close();
+    this->rightInput->close();
+  }
+
+  bool JoinOperator::execute(int numAvailableBufPages, File &resultFile) {
+    if (this->isComplete)
+      return true;
+
+    this->numAvailableBufPages = numAvailableBufPages;
+    this->tempFilePrefix = resultFile.filename();
+    FileSink sink(resultFile, this->bufMgr);
+    sink.write(*this);
+    this->numIOs += sink.getNumPages();
+
+    // the pages of the input tables read through the buffer pool must not
+    // outlive their File objects
+    if (this->leftScan != NULL) {
+      this->numIOs += this->leftScan->getNumReadPages();
+      this->bufMgr->flushFile(&(this->leftScan->getFile()));
+    }
+    if (this->rightScan != NULL) {
+      this->numIOs += this->rightScan->getNumReadPages();
+      this->bufMgr->flushFile(&(this->rightScan->getFile()));
+    }
+
+    this->isComplete = true;
+    return true;
+  }
+
+  void OnePassJoinOperator::open() {
+    std::cout << "... executing one-pass join" << "\n";
+    JoinOperator::open();
+
+    // build stage, a batch of left tuples at a time; the hash table may take
+    // the buffer pages but the ones reading the right input and writing the
+    // result
+    std::size_t budget = max(this->numAvailableBufPages - 2, 1) * Page::SIZE;
+    std::size_t buildSize = 0;
+    TupleBatch buildBatch(this->leftTupleLayout);
+    this->leftInput->open();
+    while (this->leftInput->nextBatch(buildBatch)) {
+      buildBatch.getKeys(this->joinAttrsIDLeft, this->batchKeyData, this->batchKeyOffsets);
+      for (int i = 0; i < buildBatch.getNumRows(); i++) {
+        RecordView record = buildBatch.getRow(i);
+        if (this->isRadixPartitioned) {
+          this->radixHashTable.insert(this->getBatchKey(i), record);
+          buildSize = this->radixHashTable.getSize();
         } else {
-          vector<string> values;
-          values.push_back(record);
-          bufferMap.insert(pair<string, vector<string>>(key, values));
+          this->hashTable.insert(this->getBatchKey(i), record);
+          buildSize = this->hashTable.getSize();
         }
-        itPage++;
-        this->numIOs++;
-        this->numUsedBufPages++;
-      }
-      itLeftFile++;
-    }
-
-//    for (auto &x : bufferMap) {
-//      string key = x.first;
-//      vector<string> value = x.second;
-//      std::cout << "key: " << key << endl;
-//      for (unsigned int i = 0; i < value.size(); i++) {
-//        std::cout << "\t" << value[i] << endl;
-//      }
-//    }
-
-// probe stage
-    while (itRightFile != rightFile->end()) {
-      Page page = *(itRightFile);
-      PageIterator itPage = page.begin();
-      while (itPage != page.end()) {
-        this->bufMgr->allocPage(resultFilePointer, resultPageNo, resultPage);
-        string record = *(itPage);
-//        std::cout << "record(pageNo: " << page.page_number() << ") - '" << record
-//            << "'\n";
-        vector<string> attrs = split(record, "\t");
-        string key = "";
-        for (unsigned int i = 0; i < joinAttrsIDRight.size(); i++) {
-          /*
-           * about the 'attrs[joinAttrsIDRight[i] + 1]'.
-           *   this is according to the format of tuples stored in a Page,
-           *   which is like "table_name \t attr1 \t attr2 \t ... "
-           */
-          key = key + attrs[joinAttrsIDRight[i] + 1];
+        if (buildSize > budget) {
+          // a one-pass join needs the whole left input in memory
+          this->leftInput->close();
+          throw BufferExceededException();
         }
-        if (bufferMap.count(key) > 0) { // join the tuples
-          vector<string> tuples = bufferMap[key];
-          for (unsigned int i = 0; i < tuples.size(); i++) {
-            string token = tuples[i];
-            string joinedTuple = "";
-            // add the left part
-            vector<string> leftTokens = split(token, "\t");
-            for (unsigned int j = 1; j < leftTokens.size(); j++) {
-              joinedTuple = joinedTuple + leftTokens[j] + "\t";
-            }
+      }
+    }
+    this->leftInput->close();
+    if (this->isRadixPartitioned) {
+      this->radixHashTable.build();
+      this->numRadixPartitions = this->radixHashTable.getNumPartitions();
+      this->numRadixPasses = this->radixHashTable.getNumPasses();
+      buildSize = this->radixHashTable.getSize();
+    }
+    // the hash table, a page of the right table and a result page
+    this->numUsedBufPages = (buildSize + Page::SIZE - 1) / Page::SIZE + 2;
 
-            // add the right part
-            vector<string> rightTokens = split(record, "\t");
-            for (unsigned int j = 1; j < rightTokens.size(); j++) {
-              bool contains = false;
-              for (unsigned int k = 0; k < joinAttrsIDRight.size(); k++) {
-                if (j - 1 == (unsigned int) joinAttrsIDRight[k]) {
-                  contains = true;
-                  break;
-                }
-              }
-              if (contains == false) {
-                joinedTuple = joinedTuple + rightTokens[j] + "\t";
-              }
-            }
+    // probe stage
+    this->rightInput->open();
+  }
 
-//            std::cout << "joined: " << joinedTuple << endl;
-            resultPage->insertRecord("result\t" + joinedTuple);
-            this->numResultTuples++;
-          }
-        } else { // do nothing
-        }
-        this->bufMgr->unPinPage(resultFilePointer, resultPageNo, true);
-        this->bufMgr->flushFile(resultFilePointer);
-        itPage++;
-        this->numIOs++;
-        this->numUsedBufPages++;
+  bool OnePassJoinOperator::fill() {
+    if (this->rightInput->nextBatch(this->probeBatch) == false) {
+      return false;
+    }
+    if (this->isRadixPartitioned) {
+      this->probeRadix(this->probeBatch);
+    } else {
+      this->probe(this->hashTable, this->probeBatch, this->joinAttrsIDRight,
+          true /* isBuildLeft */);
+    }
+    return true;
+  }
+
+  void OnePassJoinOperator::probeRadix(TupleBatch &batch) {
+    // hash all the keys, then sort the tuples by partition so that the
+    // lookups of a partition follow each other
+    batch.getKeys(this->joinAttrsIDRight, this->batchKeyData, this->batchKeyOffsets);
+    const vector<uint16_t> &selection = batch.getSelection();
+    this->batchHashes.resize(selection.size());
+    this->probeOrder.resize(selection.size());
+    for (unsigned int i = 0; i < selection.size(); i++) {
+      this->batchHashes[i] = JoinHashTable::hashKey(this->getBatchKey(i));
+      this->probeOrder[i] = (this->radixHashTable.getPartition(this->batchHashes[i]) << 16) | i;
+    }
+    std::sort(this->probeOrder.begin(), this->probeOrder.end());
+
+    for (unsigned int i = 0; i < this->probeOrder.size(); i++) {
+      unsigned int index = this->probeOrder[i] & 0xffff;
+      this->probeMatches.clear();
+      this->radixHashTable.find(this->getBatchKey(index), this->batchHashes[index],
+          this->probeMatches);
+      RecordView record = batch.getRow(selection[index]);
+      for (unsigned int j = 0; j < this->probeMatches.size(); j++) {
+        this->resultTuples.push_back(this->joinTuples(this->probeMatches[j], record));
       }
-      itRightFile++;
     }
+  }
 
-    this->isComplete = true;
-    return true;
+  void OnePassJoinOperator::printRunningStats() const {
+    JoinOperator::printRunningStats();
+    if (this->isRadixPartitioned) {
+      cout << "# Radix Partitions: " << this->numRadixPartitions << " ("
+          << this->numRadixPasses << " passes)" << endl;
+    }
+  }
+
+  void OnePassJoinOperator::close() {
+    this->hashTable.clear();
+    this->radixHashTable.clear();
+    JoinOperator::close();
   }
 
-  bool NestedLoopJoinOperator::execute(int numAvailableBufPages, File &resultFile) {
+  void NestedLoopJoinOperator::open() {
     std::cout << "... executing nested-loop join" << "\n";
-    if (this->isComplete)
-      return true;
+    JoinOperator::open();
+    // a block of left tuples fills the buffer pages but the ones reading the
+    // right input and writing the result
+    this->blockHashTable.setBudget(max(this->numAvailableBufPages - 2, 1) * Page::SIZE);
+    this->leftInput->open();
+    this->isLeftExhausted = false;
+    this->isRightOpen = false;
+  }
 
-    this->resultTableSchema.print();
+  bool NestedLoopJoinOperator::fill() {
+    while (true) {
+      // probe stage; the right input is scanned once per block
+      if (this->isRightOpen) {
+        if (this->rightInput->nextBatch(this->probeBatch)) {
+          this->probe(this->blockHashTable, this->probeBatch, this->joinAttrsIDRight,
+              true /* isBuildLeft */);
+          return true;
+        }
+        this->rightInput->close();
+        this->isRightOpen = false;
+        this->blockHashTable.clear();
+      }
+      if (this->isLeftExhausted) {
+        return false;
+      }
 
-    this->numResultTuples = 0;
-    this->numUsedBufPages = 0;
-    this->numIOs = 0;
+      // build stage; a block of left tuples fills the hash table up to its
+      // budget
+      RecordView leftRecord;
+      while (this->blockHashTable.isFull() == false) {
+        if (this->leftInput->next(leftRecord) == false) {
+          this->isLeftExhausted = true;
+          break;
+        }
+        string leftKey = getJoinKey(TupleView(this->leftTupleLayout, leftRecord),
+            this->joinAttrsIDLeft);
+        this->blockHashTable.insert(leftKey, leftRecord);
+      }
+      if (this->blockHashTable.empty()) {
+        return false;
+      }
+      this->numUsedBufPages = max(this->numUsedBufPages,
+          (int) ((this->blockHashTable.getSize() + Page::SIZE - 1) / Page::SIZE) + 2);
+      this->rightInput->open();
+      this->isRightOpen = true;
+    }
+  }
 
-    // size of a block when executing nested-loop join
-    const int blockSize = numAvailableBufPages;
+  void NestedLoopJoinOperator::close() {
+    this->blockHashTable.clear();
+    this->isRightOpen = false;
+    JoinOperator::close();
+  }
 
-    // result output
-    File *resultFilePointer = &resultFile;
-    PageId resultPageNo;
-    Page *resultPage;
+  void SortMergeJoinOperator::printRunningStats() const {
+    JoinOperator::printRunningStats();
+    cout << "# Left Runs: " << this->numLeftRuns << " (" << this->numLeftPasses
+        << " passes)" << endl;
+    cout << "# Right Runs: " << this->numRightRuns << " (" << this->numRightPasses
+        << " passes)" << endl;
+  }
 
-    // hash structure
-    vector<string> joinAttrs;
-    vector<int> joinAttrsIDLeft;
-    vector<int> joinAttrsIDRight;
-    vector<int> joinAttrsIDResult;
-    map<string, vector<string>> bufferMap;
+  void SortMergeJoinOperator::open() {
+    std::cout << "... executing sort-merge join" << "\n";
+    JoinOperator::open();
 
-    // left table; right table
-    File *leftFile = &(this->leftTableFile);
-    File *rightFile = &(this->rightTableFile);
-    FileIterator itRightFile = rightFile->begin();
-    FileIterator itLeftFile = leftFile->begin();
+    // sort stage, one input after the other so each sort has all the buffer pages
+    this->leftSortedFile = createTempFile(this->tempFilePrefix + ".left.sorted");
+    this->rightSortedFile = createTempFile(this->tempFilePrefix + ".right.sorted");
+    ExternalSort leftSort(this->leftTableSchema, this->joinAttrsIDLeft, this->bufMgr);
+    ExternalSort rightSort(this->rightTableSchema, this->joinAttrsIDRight, this->bufMgr);
+    vector<PageId> leftPages = leftSort.sort(*(this->leftInput), this->numAvailableBufPages,
+        *(this->leftSortedFile));
+    vector<PageId> rightPages = rightSort.sort(*(this->rightInput),
+        this->numAvailableBufPages, *(this->rightSortedFile));
+    this->numLeftRuns = leftSort.getNumRuns();
+    this->numRightRuns = rightSort.getNumRuns();
+    this->numLeftPasses = leftSort.getNumPasses();
+    this->numRightPasses = rightSort.getNumPasses();
+    this->numIOs += leftSort.getNumIOs() + rightSort.getNumIOs();
+    this->numUsedBufPages = max(this->numAvailableBufPages, 3);
 
-    // confirm the attributes' names and ids used for one-pass join
-    int leftTableAttrsNum = this->leftTableSchema.getAttrCount();
-    int rightTableAttrsNum = this->rightTableSchema.getAttrCount();
-    int resultTableAttrsNum = this->resultTableSchema.getAttrCount();
-    for (int i = 0; i < leftTableAttrsNum; i++) {
-      string leftAttrName = this->leftTableSchema.getAttrName(i);
-      for (int j = 0; j < rightTableAttrsNum; j++) {
-        string rightAttrName = this->rightTableSchema.getAttrName(j);
-        if (leftAttrName == rightAttrName) {
-          joinAttrs.push_back(leftAttrName);
-          joinAttrsIDLeft.push_back(i);
-          joinAttrsIDRight.push_back(j);
-//          std::cout << "join attribute: " << leftAttrName << endl;
-//          std::cout << "id in left: " << i << endl;
-//          std::cout << "id in right: " << j << endl;
+    // merge stage
+    this->leftReader = new RunReader(this->bufMgr, this->leftSortedFile, leftPages);
+    this->rightReader = new RunReader(this->bufMgr, this->rightSortedFile, rightPages);
+    this->nextLeft();
+    this->nextRight();
+    this->leftGroup.clear();
+  }
+
+  void SortMergeJoinOperator::nextLeft() {
+    this->hasLeft = this->leftReader->next(this->leftRecord);
+    if (this->hasLeft) {
+      // the sorted files are in the order of the join keys, which are composed
+      // the way ExternalSort composes its sort keys
+      this->leftKey = getJoinKey(TupleView(this->leftTupleLayout, this->leftRecord),
+          this->joinAttrsIDLeft);
+    }
+  }
+
+  void SortMergeJoinOperator::nextRight() {
+    this->hasRight = this->rightReader->next(this->rightRecord);
+    if (this->hasRight) {
+      this->rightKey = getJoinKey(TupleView(this->rightTupleLayout, this->rightRecord),
+          this->joinAttrsIDRight);
+    }
+  }
+
+  bool SortMergeJoinOperator::fill() {
+    // join the next right tuple with the left tuples of the same key
+    if (this->leftGroup.empty() == false) {
+      if (this->hasRight && this->rightKey == this->groupKey) {
+        for (unsigned int i = 0; i < this->leftGroup.size(); i++) {
+          this->resultTuples.push_back(this->joinTuples(this->leftGroup[i], this->rightRecord));
         }
+        this->nextRight();
+        return true;
       }
+      this->leftGroup.clear();
     }
-    for (int i = 0; i < resultTableAttrsNum; i++) {
-      string resultAttrName = this->resultTableSchema.getAttrName(i);
-      for (unsigned int j = 0; j < joinAttrs.size(); j++) {
-        string joinAttrName = joinAttrs[j];
-        if (joinAttrName == resultAttrName) {
-          joinAttrsIDResult.push_back(i);
+
+    while (this->hasLeft && this->hasRight) {
+      if (this->leftKey < this->rightKey) {
+        this->nextLeft();
+      } else if (this->rightKey < this->leftKey) {
+        this->nextRight();
+      } else {
+        // keep the left tuples with this key, then join each right tuple with them
+        this->groupKey = this->leftKey;
+        while (this->hasLeft && this->leftKey == this->groupKey) {
+          this->leftGroup.push_back(this->leftRecord.str());
+          this->nextLeft();
         }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void SortMergeJoinOperator::close() {
+    this->leftGroup.clear();
+    this->hasLeft = false;
+    this->hasRight = false;
+    if (this->leftReader != NULL) {
+      this->leftReader->close();
+      this->rightReader->close();
+      this->numIOs += this->leftReader->getNumReadPages()
+          + this->rightReader->getNumReadPages();
+      delete this->leftReader;
+      delete this->rightReader;
+      this->leftReader = NULL;
+      this->rightReader = NULL;
+    }
+    if (this->leftSortedFile != NULL) {
+      removeTempFile(this->bufMgr, this->leftSortedFile);
+      removeTempFile(this->bufMgr, this->rightSortedFile);
+      this->leftSortedFile = NULL;
+      this->rightSortedFile = NULL;
+    }
+    JoinOperator::close();
+  }
+
+  void BucketJoinOperator::createBucketFiles(int firstBucket) {
+    this->leftBucketFiles.assign(this->numBuckets, (File*) NULL);
+    this->rightBucketFiles.assign(this->numBuckets, (File*) NULL);
+    this->leftBucketPages.assign(this->numBuckets, vector<PageId>());
+    this->rightBucketPages.assign(this->numBuckets, vector<PageId>());
+    for (int i = firstBucket; i < this->numBuckets; i++) {
+      stringstream leftName;
+      stringstream rightName;
+      leftName << this->tempFilePrefix << ".left." << i;
+      rightName << this->tempFilePrefix << ".right." << i;
+      this->leftBucketFiles[i] = createTempFile(leftName.str());
+      this->rightBucketFiles[i] = createTempFile(rightName.str());
+    }
+    this->bucketLevels.assign(this->numBuckets, 0);
+    this->firstSubBuckets.assign(this->numBuckets, -1);
+    this->numBucketBlocks.assign(this->numBuckets, 0);
+  }
+
+  void BucketJoinOperator::countBucketPages() {
+    this->numLeftBucketPages.clear();
+    this->numRightBucketPages.clear();
+    for (int i = 0; i < this->numBuckets; i++) {
+      this->numLeftBucketPages.push_back(this->leftBucketPages[i].size());
+      this->numRightBucketPages.push_back(this->rightBucketPages[i].size());
+    }
+  }
+
+  BucketId BucketJoinOperator::subHash(const string &key, int level,
+      int numSubBuckets) const {
+    // the keys of a bucket agree on the hash function of the level before, so
+    // the hash of the key is mixed with the level before it picks a bucket
+    uint64_t value = JoinHashTable::hashKey(key) + level * 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 33)) * 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    return value % numSubBuckets;
+  }
+
+  void BucketJoinOperator::splitBucket(File *file, const vector<PageId> &pages,
+      const TupleLayout &tupleLayout, const vector<int> &joinAttrsID, int level,
+      int firstSubBucket, vector<File*> &bucketFiles, vector<vector<PageId>> &bucketPages,
+      vector<int> &bucketTuples) {
+    // the page of each new bucket currently pinned as its output buffer
+    int numSubBuckets = this->numBuckets - firstSubBucket;
+    vector<PageId> bucketPageNos(numSubBuckets, (PageId) Page::INVALID_NUMBER);
+    vector<Page*> bucketPagePointers(numSubBuckets, (Page*) NULL);
+
+    RunReader reader(this->bufMgr, file, pages);
+    RecordView record;
+    while (reader.next(record)) {
+      int subBucket = this->subHash(getJoinKey(TupleView(tupleLayout, record), joinAttrsID),
+          level, numSubBuckets);
+      BucketId bucketId = firstSubBucket + subBucket;
+      if (appendRecord(this->bufMgr, bucketFiles[bucketId], record, bucketPageNos[subBucket],
+          bucketPagePointers[subBucket])) {
+        bucketPages[bucketId].push_back(bucketPageNos[subBucket]);
       }
+      bucketTuples[bucketId]++;
     }
-//    printVectorInt(joinAttrsIDLeft);
-//    printVectorInt(joinAttrsIDRight);
-//    printVectorInt(joinAttrsIDResult);
-
-    int blockUsedCount = 0;
-    // build stage
-    while (itLeftFile != leftFile->end()) {
-      Page leftPage = *(itLeftFile);
-      PageIterator itLeftPage = leftPage.begin();
-      this->bufMgr->allocPage(resultFilePointer, resultPageNo, resultPage);
-      while (itLeftPage != leftPage.end()) {
-        string leftRecord = *(itLeftPage);
-//        std::cout << "record(pageNo: " << leftPage.page_number() << ") - '"
-//            << leftRecord << "'\n";
-        vector<string> leftAttrs = split(leftRecord, "\t");
-        string leftKey = "";
-        for (unsigned int i = 0; i < joinAttrsIDLeft.size(); i++) {
-          /*
-           * about the 'leftAttrs[joinAttrsIDLeft[i] + 1]'.
-           *   this is according to the format of tuples stored in a Page,
-           *   which is like "table_name \t attr1 \t attr2 \t ... "
-           */
-          leftKey = leftKey + leftAttrs[joinAttrsIDLeft[i] + 1];
+    reader.close();
+    this->numIOs += reader.getNumReadPages();
+
+    // write the new buckets out to disk
+    for (int i = 0; i < numSubBuckets; i++) {
+      if (bucketPageNos[i] != Page::INVALID_NUMBER) {
+        this->bufMgr->unPinPage(bucketFiles[firstSubBucket + i], bucketPageNos[i], true);
+      }
+      this->bufMgr->flushFile(bucketFiles[firstSubBucket + i]);
+      this->numIOs += bucketPages[firstSubBucket + i].size();
+    }
+  }
+
+  int BucketJoinOperator::addBuckets(int numNewBuckets, int level) {
+    int firstNewBucket = this->numBuckets;
+    for (int i = firstNewBucket; i < firstNewBucket + numNewBuckets; i++) {
+      stringstream leftName;
+      stringstream rightName;
+      leftName << this->tempFilePrefix << ".left." << i;
+      rightName << this->tempFilePrefix << ".right." << i;
+      this->leftBucketFiles.push_back(createTempFile(leftName.str()));
+      this->rightBucketFiles.push_back(createTempFile(rightName.str()));
+      this->leftBucketPages.push_back(vector<PageId>());
+      this->rightBucketPages.push_back(vector<PageId>());
+      this->numLeftBucketTuples.push_back(0);
+      this->numRightBucketTuples.push_back(0);
+      this->bucketLevels.push_back(level);
+      this->firstSubBuckets.push_back(-1);
+      this->numBucketBlocks.push_back(0);
+    }
+    this->numBuckets += numNewBuckets;
+    return firstNewBucket;
+  }
+
+  void BucketJoinOperator::repartitionBucket(int bucket) {
+    int level = this->bucketLevels[bucket] + 1;
+    int numSubBuckets = max(this->numAvailableBufPages - 1, 2);
+    int firstSubBucket = this->addBuckets(numSubBuckets, level);
+    this->firstSubBuckets[bucket] = firstSubBucket;
+
+    // the pages of the bucket are copied, since the vectors of pages grow
+    vector<PageId> leftPages = this->leftBucketPages[bucket];
+    vector<PageId> rightPages = this->rightBucketPages[bucket];
+    this->splitBucket(this->leftBucketFiles[bucket], leftPages, this->leftTupleLayout,
+        this->joinAttrsIDLeft, level, firstSubBucket, this->leftBucketFiles,
+        this->leftBucketPages, this->numLeftBucketTuples);
+    this->splitBucket(this->rightBucketFiles[bucket], rightPages, this->rightTupleLayout,
+        this->joinAttrsIDRight, level, firstSubBucket, this->rightBucketFiles,
+        this->rightBucketPages, this->numRightBucketTuples);
+    for (int i = firstSubBucket; i < this->numBuckets; i++) {
+      this->numLeftBucketPages.push_back(this->leftBucketPages[i].size());
+      this->numRightBucketPages.push_back(this->rightBucketPages[i].size());
+    }
+    // one buffer page is used to read the bucket, the others buffer the new
+    // buckets
+    this->numUsedBufPages = max(this->numUsedBufPages, numSubBuckets + 1);
+
+    removeTempFile(this->bufMgr, this->leftBucketFiles[bucket]);
+    removeTempFile(this->bufMgr, this->rightBucketFiles[bucket]);
+    this->leftBucketFiles[bucket] = NULL;
+    this->rightBucketFiles[bucket] = NULL;
+    this->leftBucketPages[bucket].clear();
+    this->rightBucketPages[bucket].clear();
+  }
+
+  void BucketJoinOperator::closeBuildReader() {
+    this->buildReader->close();
+    this->numIOs += this->buildReader->getNumReadPages();
+    delete this->buildReader;
+    this->buildReader = NULL;
+    this->isBuildRecordPending = false;
+  }
+
+  bool BucketJoinOperator::buildBlock() {
+    const vector<int> &buildAttrsID =
+        this->isBucketBuildLeft ? this->joinAttrsIDLeft : this->joinAttrsIDRight;
+    const TupleLayout &buildTupleLayout =
+        this->isBucketBuildLeft ? this->leftTupleLayout : this->rightTupleLayout;
+    while (true) {
+      // a tuple left out of the last block stays valid, since its page stays
+      // pinned by the reader
+      if (this->isBuildRecordPending == false
+          && this->buildReader->next(this->pendingBuildRecord) == false) {
+        this->closeBuildReader();
+        break;
+      }
+      string key = getJoinKey(TupleView(buildTupleLayout, this->pendingBuildRecord),
+          buildAttrsID);
+      if (this->hashTable.empty() == false
+          && this->hashTable.hasSpaceFor(key, this->pendingBuildRecord) == false) {
+        this->isBuildRecordPending = true;
+        break;
+      }
+      this->hashTable.insert(key, this->pendingBuildRecord);
+      this->isBuildRecordPending = false;
+    }
+    // the hash table, a build page, a probe page and a result page
+    this->numUsedBufPages = max(this->numUsedBufPages,
+        (int) ((this->hashTable.getSize() + Page::SIZE - 1) / Page::SIZE) + 3);
+    return this->buildReader != NULL;
+  }
+
+  bool BucketJoinOperator::fillFromBuckets() {
+    while (true) {
+      if (this->probeReader != NULL) {
+        RecordView record;
+        if (this->probeReader->next(record)) {
+          this->probe(this->hashTable, record,
+              this->isBucketBuildLeft ? this->joinAttrsIDRight : this->joinAttrsIDLeft,
+              this->isBucketBuildLeft);
+          return true;
         }
-        if (bufferMap.count(leftKey) > 0) {
-          bufferMap.at(leftKey).push_back(leftRecord);
-        } else {
-          vector<string> values;
-          values.push_back(leftRecord);
-          bufferMap.insert(pair<string, vector<string>>(leftKey, values));
+        this->probeReader->close();
+        this->numIOs += this->probeReader->getNumReadPages();
+        delete this->probeReader;
+        this->probeReader = NULL;
+        this->hashTable.clear();
+      }
+
+      int i = this->joinedBucket;
+      if (this->buildReader == NULL) {
+        if (this->nextBucket >= this->numBuckets) {
+          return false;
         }
-        blockUsedCount++;
-        if ((blockUsedCount % blockSize == 0 && blockUsedCount != 0) == false) {
-          // read only bolckSize Count
-          itLeftPage++;
+
+        // build the hash table on the smaller bucket
+        i = this->nextBucket++;
+        this->isBucketBuildLeft = this->leftBucketPages[i].size()
+            < this->rightBucketPages[i].size()
+            || (this->leftBucketPages[i].size() == this->rightBucketPages[i].size()
+                && this->numLeftBucketTuples[i] <= this->numRightBucketTuples[i]);
+        bool isBuildLeft = this->isBucketBuildLeft;
+        File *buildFile = isBuildLeft ? this->leftBucketFiles[i] : this->rightBucketFiles[i];
+        const vector<PageId> &buildPages =
+            isBuildLeft ? this->leftBucketPages[i] : this->rightBucketPages[i];
+        const vector<PageId> &probePages =
+            isBuildLeft ? this->rightBucketPages[i] : this->leftBucketPages[i];
+        if (buildPages.empty() || probePages.empty()) {
           continue;
-        } else {
-          // do nothing
-          this->numIOs++;
-//          std::cout << "block used count: " << blockUsedCount << endl;
         }
-        // probe stage
-        itRightFile = rightFile->begin();
-        while (itRightFile != rightFile->end()) {
-          Page rightPage = *(itRightFile);
-          PageIterator itRightPage = rightPage.begin();
-          while (itRightPage != rightPage.end()) {
-            string rightRecord = *(itRightPage);
-//            std::cout << "record(pageNo: " << rightPage.page_number() << ") - '"
-//                << rightRecord << "'\n";
-            vector<string> rightAttrs = split(rightRecord, "\t");
-            string rightKey = "";
-            for (unsigned int i = 0; i < joinAttrsIDRight.size(); i++) {
-              /*
-               * about the 'rightAttrs[joinAttrsIDRight[i] + 1]'.
-               *   this is according to the format of tuples stored in a Page,
-               *   which is like "table_name \t attr1 \t attr2 \t ... "
-               */
-              rightKey = rightKey + rightAttrs[joinAttrsIDRight[i] + 1];
-            }
-            if (bufferMap.count(rightKey) > 0) {
-              // join the tuples
-              vector<string> tuples = bufferMap[rightKey];
-              for (unsigned int i = 0; i < tuples.size(); i++) {
-                string token = tuples[i];
-                string joinedTuple = "";
-                // add the left part
-                vector<string> leftTokens = split(token, "\t");
-                for (unsigned int j = 1; j < leftTokens.size(); j++) {
-                  joinedTuple = joinedTuple + leftTokens[j] + "\t";
-                }
-
-                // add the right part
-                vector<string> rightTokens = split(rightRecord, "\t");
-                for (unsigned int j = 1; j < rightTokens.size(); j++) {
-                  bool contains = false;
-                  for (unsigned int k = 0; k < joinAttrsIDRight.size(); k++) {
-                    if (j - 1 == (unsigned int) joinAttrsIDRight[k]) {
-                      contains = true;
-                      break;
-                    }
-                  }
-                  if (contains == false) {
-                    joinedTuple = joinedTuple + rightTokens[j] + "\t";
-                  }
-                }
-
-//                std::cout << "joined: " << joinedTuple << endl;
-                resultPage->insertRecord("result\t" + joinedTuple);
-                this->numResultTuples++;
-              }
-            } else {
-              // do nothing
-            }
-            itRightPage++;
-            this->numIOs++;
-          } // end of right page iteration
-          itRightFile++;
-        } // end of right file iteration
-        bufferMap.clear();
-        itLeftPage++;
-      } // end of left page iteration
-      this->bufMgr->unPinPage(resultFilePointer, resultPageNo, true);
-      this->bufMgr->flushFile(resultFilePointer);
-      itLeftFile++;
-    } // end of left file iteration
-
-    this->numUsedBufPages = blockSize + 1;
 
-    this->isComplete = true;
-    return true;
+        // the hash table may take the buffer pages but the ones reading the
+        // buckets and writing the result; a bucket known to be larger is split
+        // without building it
+        int maxBuildPages = max(this->numAvailableBufPages - 3, 1);
+        bool isSplittable = this->bucketLevels[i] < MAX_PARTITION_LEVELS;
+        if (isSplittable && (int) buildPages.size() > maxBuildPages) {
+          this->repartitionBucket(i);
+          continue;
+        }
+        this->hashTable.setBudget(maxBuildPages * Page::SIZE);
+        this->joinedBucket = i;
+        this->buildReader = new RunReader(this->bufMgr, buildFile, buildPages);
+        if (this->buildBlock() && isSplittable) {
+          this->closeBuildReader();
+          this->hashTable.clear();
+          this->repartitionBucket(i);
+          continue;
+        }
+      } else {
+        // join the next block of build tuples with the whole probe side again
+        this->buildBlock();
+      }
+
+      if (this->hashTable.empty() == false) {
+        File *probeFile =
+            this->isBucketBuildLeft ? this->rightBucketFiles[i] : this->leftBucketFiles[i];
+        const vector<PageId> &probePages =
+            this->isBucketBuildLeft ? this->rightBucketPages[i] : this->leftBucketPages[i];
+        this->numBucketBlocks[i]++;
+        this->probeReader = new RunReader(this->bufMgr, probeFile, probePages);
+      }
+    }
+  }
+
+  void BucketJoinOperator::printBucketStats(int bucket) const {
+    cout << "  bucket " << bucket;
+    if (this->bucketLevels[bucket] > 0) {
+      cout << " (level " << this->bucketLevels[bucket] << ")";
+    }
+    cout << ": " << this->numLeftBucketTuples[bucket] << " left tuples in "
+        << this->numLeftBucketPages[bucket] << " pages, " << this->numRightBucketTuples[bucket]
+        << " right tuples in " << this->numRightBucketPages[bucket] << " pages";
+    if (this->firstSubBuckets[bucket] >= 0) {
+      cout << ", split into buckets " << this->firstSubBuckets[bucket] << "-"
+          << this->firstSubBuckets[bucket] + max(this->numAvailableBufPages - 1, 2) - 1;
+    } else if (this->numBucketBlocks[bucket] > 1) {
+      cout << ", joined in " << this->numBucketBlocks[bucket] << " blocks";
+    }
+    cout << endl;
+  }
+
+  void BucketJoinOperator::close() {
+    if (this->buildReader != NULL) {
+      this->closeBuildReader();
+    }
+    if (this->probeReader != NULL) {
+      this->probeReader->close();
+      delete this->probeReader;
+      this->probeReader = NULL;
+    }
+    this->hashTable.clear();
+    for (unsigned int i = 0; i < this->leftBucketFiles.size(); i++) {
+      if (this->leftBucketFiles[i] != NULL) {
+        removeTempFile(this->bufMgr, this->leftBucketFiles[i]);
+        removeTempFile(this->bufMgr, this->rightBucketFiles[i]);
+      }
+    }
+    this->leftBucketFiles.clear();
+    this->rightBucketFiles.clear();
+    JoinOperator::close();
   }
 
   BucketId GraceHashJoinOperator::hash(const string &key) const {
@@ -457,15 +1442,605 @@ namespace badgerdb {
     return strHash(key) % this->numBuckets;
   }
 
-  bool GraceHashJoinOperator::execute(int numAvailableBufPages, File &resultFile) {
+  void GraceHashJoinOperator::printRunningStats() const {
+    JoinOperator::printRunningStats();
+    cout << "# Buckets: " << this->numBuckets << endl;
+    for (unsigned int i = 0; i < this->numLeftBucketPages.size(); i++) {
+      this->printBucketStats(i);
+    }
+  }
+
+  void GraceHashJoinOperator::partition(Operator &input, const TupleLayout &tupleLayout,
+      const vector<int> &joinAttrsID, vector<File*> &bucketFiles,
+      vector<vector<PageId>> &bucketPages, vector<int> &bucketTuples) {
+    // the page of each bucket currently pinned as its output buffer
+    vector<PageId> bucketPageNos(this->numBuckets, (PageId) Page::INVALID_NUMBER);
+    vector<Page*> bucketPagePointers(this->numBuckets, (Page*) NULL);
+    bucketTuples.assign(this->numBuckets, 0);
+
+    RecordView record;
+    input.open();
+    while (input.next(record)) {
+      BucketId bucketId = this->hash(getJoinKey(TupleView(tupleLayout, record),
+          joinAttrsID));
+      if (appendRecord(this->bufMgr, bucketFiles[bucketId], record,
+          bucketPageNos[bucketId], bucketPagePointers[bucketId])) {
+        bucketPages[bucketId].push_back(bucketPageNos[bucketId]);
+      }
+      bucketTuples[bucketId]++;
+    }
+    input.close();
+
+    // write the buckets out to disk
+    for (int i = 0; i < this->numBuckets; i++) {
+      if (bucketPageNos[i] != Page::INVALID_NUMBER) {
+        this->bufMgr->unPinPage(bucketFiles[i], bucketPageNos[i], true);
+      }
+      this->bufMgr->flushFile(bucketFiles[i]);
+      this->numIOs += bucketPages[i].size();
+    }
+  }
+
+  void GraceHashJoinOperator::open() {
+    std::cout << "... executing grace hash join" << "\n";
+    JoinOperator::open();
+
+    // one buffer page is used to read the input, the others buffer the buckets
+    this->numBuckets = max(this->numAvailableBufPages - 1, 1);
+    this->createBucketFiles(0);
+
+    // partition stage
+    this->partition(*(this->leftInput), this->leftTupleLayout, this->joinAttrsIDLeft,
+        this->leftBucketFiles, this->leftBucketPages, this->numLeftBucketTuples);
+    this->partition(*(this->rightInput), this->rightTupleLayout, this->joinAttrsIDRight,
+        this->rightBucketFiles, this->rightBucketPages, this->numRightBucketTuples);
+    this->numUsedBufPages = this->numBuckets + 1;
+    this->countBucketPages();
+
+    // build and probe stage, one pair of buckets at a time
+    this->nextBucket = 0;
+  }
+
+  bool GraceHashJoinOperator::fill() {
+    return this->fillFromBuckets();
+  }
+
+  BucketId HybridHashJoinOperator::hash(const string &key) const {
+    std::hash<string> strHash;
+    std::size_t value = strHash(key);
+    // the first memoryShare of the hash values stays in memory as bucket 0
+    if ((int) (value % 1000) < this->memoryShare) {
+      return 0;
+    }
+    return 1 + (value / 1000) % (this->numBuckets - 1);
+  }
+
+  BucketId HybridHashJoinOperator::overflowHash(const string &key) const {
+    std::hash<string> strHash;
+    return 1 + (strHash(key) / 1000) % (this->numBuckets - 1);
+  }
+
+  void HybridHashJoinOperator::printRunningStats() const {
+    JoinOperator::printRunningStats();
+    cout << "# Buckets: " << this->numBuckets << endl;
+    cout << "# In-Memory Buffer Pages: " << this->numMemPages << endl;
+    for (unsigned int i = 0; i < this->numLeftBucketPages.size(); i++) {
+      if (i == 0) {
+        cout << "  bucket 0: " << this->numLeftBucketTuples[0] << " left tuples in memory, "
+            << this->numRightBucketTuples[0] << " right tuples in memory";
+        if (this->numOverflowTuples > 0) {
+          cout << ", " << this->numOverflowTuples << " tuples spilled out of memory";
+        }
+        cout << endl;
+      } else {
+        this->printBucketStats(i);
+      }
+    }
+  }
+
+  void HybridHashJoinOperator::flushBuckets(const vector<File*> &bucketFiles,
+      const vector<vector<PageId>> &bucketPages) {
+    for (int i = 1; i < this->numBuckets; i++) {
+      if (this->bucketPageNos[i] != Page::INVALID_NUMBER) {
+        this->bufMgr->unPinPage(bucketFiles[i], this->bucketPageNos[i], true);
+        this->bucketPageNos[i] = Page::INVALID_NUMBER;
+      }
+      if (bucketFiles[i] != NULL) {
+        this->bufMgr->flushFile(bucketFiles[i]);
+        this->numIOs += bucketPages[i].size();
+      }
+    }
+  }
+
+  void HybridHashJoinOperator::open() {
+    std::cout << "... executing hybrid hash join" << "\n";
+    JoinOperator::open();
+
+    // build the in-memory hash table on the smaller input; an input of
+    // unknown size is taken to be the larger one
+    int numLeftPages = this->leftInput->estimateNumPages();
+    int numRightPages = this->rightInput->estimateNumPages();
+    this->isBuildLeft = numRightPages < 0 || (numLeftPages >= 0 && numLeftPages <= numRightPages);
+    bool isBuildLeft = this->isBuildLeft;
+    int numBuildPages = isBuildLeft ? numLeftPages : numRightPages;
+    Operator *buildInput = isBuildLeft ? this->leftInput : this->rightInput;
+    const vector<int> &buildAttrsID = isBuildLeft ? this->joinAttrsIDLeft : this->joinAttrsIDRight;
+    const TupleLayout &buildTupleLayout =
+        isBuildLeft ? this->leftTupleLayout : this->rightTupleLayout;
+
+    // Besides the hash table of bucket 0, each spilled bucket needs an output
+    // page, and one page each is needed to read the input and write the result.
+    // Spill as few buckets as possible such that each spilled bucket fits in
+    // the buffer pool when it is joined later. A build input of unknown size
+    // is planned for the largest one that can be joined. The tuples of bucket
+    // 0 that do not fit in the hash table after all are spilled with the
+    // other buckets; if no bucket is spilled, one page of the hash table is
+    // kept for the output page of a bucket taking them.
+    int availablePages = max(this->numAvailableBufPages, 3);
+    if (numBuildPages < 0) {
+      numBuildPages = (availablePages - 2) * (availablePages - 2);
+    }
+    int numSpilled = 0;
+    while (numSpilled < availablePages - 2
+        && numBuildPages - (availablePages - 2 - numSpilled)
+            > numSpilled * (availablePages - 2)) {
+      numSpilled++;
+    }
+    this->numBuckets = numSpilled + 1;
+    this->numMemPages = availablePages - 2 - numSpilled;
+    this->memoryShare = numSpilled == 0 ? 1000 : 1000 * this->numMemPages / numBuildPages;
+    int numTablePages = numSpilled == 0 ? this->numMemPages - 1 : this->numMemPages;
+    this->hashTable.setBudget(max(numTablePages, 1) * Page::SIZE);
+
+    // bucket files of the spilled buckets, bucket 0 has none
+    this->createBucketFiles(1);
+    vector<File*> &buildBucketFiles = isBuildLeft ? this->leftBucketFiles : this->rightBucketFiles;
+    vector<vector<PageId>> &buildBucketPages =
+        isBuildLeft ? this->leftBucketPages : this->rightBucketPages;
+    this->numLeftBucketTuples.assign(this->numBuckets, 0);
+    this->numRightBucketTuples.assign(this->numBuckets, 0);
+    vector<int> &buildBucketTuples =
+        isBuildLeft ? this->numLeftBucketTuples : this->numRightBucketTuples;
+
+    // the page of each spilled bucket currently pinned as its output buffer
+    this->bucketPageNos.assign(this->numBuckets, (PageId) Page::INVALID_NUMBER);
+    this->bucketPagePointers.assign(this->numBuckets, (Page*) NULL);
+    this->overflowBuckets.assign(this->numBuckets, false);
+    this->numOverflowTuples = 0;
+
+    // partition the build side, keeping bucket 0 in the hash table
+    RecordView record;
+    buildInput->open();
+    while (buildInput->next(record)) {
+      string key = getJoinKey(TupleView(buildTupleLayout, record), buildAttrsID);
+      BucketId bucketId = this->hash(key);
+      if (bucketId == 0) {
+        if (numTablePages > 0 && this->hashTable.hasSpaceFor(key, record) == true) {
+          this->hashTable.insert(key, record);
+          buildBucketTuples[0]++;
+          continue;
+        }
+        // the tuple goes to a spilled bucket, where the probe tuples of its
+        // key are sent as well
+        if (this->numBuckets == 1) {
+          this->addBuckets(1, 0);
+          this->bucketPageNos.push_back((PageId) Page::INVALID_NUMBER);
+          this->bucketPagePointers.push_back(NULL);
+          this->overflowBuckets.push_back(false);
+        }
+        bucketId = this->overflowHash(key);
+        this->overflowBuckets[bucketId] = true;
+        this->numOverflowTuples++;
+      }
+      if (appendRecord(this->bufMgr, buildBucketFiles[bucketId], record,
+          this->bucketPageNos[bucketId], this->bucketPagePointers[bucketId])) {
+        buildBucketPages[bucketId].push_back(this->bucketPageNos[bucketId]);
+      }
+      buildBucketTuples[bucketId]++;
+    }
+    buildInput->close();
+    this->flushBuckets(buildBucketFiles, buildBucketPages);
+    this->numUsedBufPages = availablePages;
+
+    // partition the probe side, joining bucket 0 with the hash table at once
+    (isBuildLeft ? this->rightInput : this->leftInput)->open();
+    this->isProbeOpen = true;
+    this->isBucketBuildLeft = isBuildLeft;
+  }
+
+  bool HybridHashJoinOperator::fill() {
+    if (this->isProbeOpen) {
+      bool isBuildLeft = this->isBuildLeft;
+      Operator *probeInput = isBuildLeft ? this->rightInput : this->leftInput;
+      const vector<int> &probeAttrsID =
+          isBuildLeft ? this->joinAttrsIDRight : this->joinAttrsIDLeft;
+      const TupleLayout &probeTupleLayout =
+          isBuildLeft ? this->rightTupleLayout : this->leftTupleLayout;
+      vector<File*> &probeBucketFiles =
+          isBuildLeft ? this->rightBucketFiles : this->leftBucketFiles;
+      vector<vector<PageId>> &probeBucketPages =
+          isBuildLeft ? this->rightBucketPages : this->leftBucketPages;
+      vector<int> &buildBucketTuples =
+          isBuildLeft ? this->numLeftBucketTuples : this->numRightBucketTuples;
+      vector<int> &probeBucketTuples =
+          isBuildLeft ? this->numRightBucketTuples : this->numLeftBucketTuples;
+
+      RecordView record;
+      if (probeInput->next(record)) {
+        string key = getJoinKey(TupleView(probeTupleLayout, record), probeAttrsID);
+        BucketId bucketId = this->hash(key);
+        if (bucketId == 0) {
+          this->probe(this->hashTable, record, probeAttrsID, isBuildLeft);
+          probeBucketTuples[0]++;
+          // the tuple is joined later with the build tuples of bucket 0 that
+          // were spilled out of memory as well
+          bucketId = this->numOverflowTuples == 0 ? 0 : this->overflowHash(key);
+          if (bucketId == 0 || this->overflowBuckets[bucketId] == false) {
+            return true;
+          }
+        }
+        if (buildBucketTuples[bucketId] > 0
+            && appendRecord(this->bufMgr, probeBucketFiles[bucketId], record,
+                this->bucketPageNos[bucketId], this->bucketPagePointers[bucketId])) {
+          // tuples whose build bucket is empty cannot join and are dropped
+          probeBucketPages[bucketId].push_back(this->bucketPageNos[bucketId]);
+        }
+        probeBucketTuples[bucketId]++;
+        return true;
+      }
+      probeInput->close();
+      this->isProbeOpen = false;
+      this->flushBuckets(probeBucketFiles, probeBucketPages);
+      this->hashTable.clear();
+      this->countBucketPages();
+
+      // join the spilled buckets one pair at a time
+      this->nextBucket = 1;
+    }
+    return this->fillFromBuckets();
+  }
+
+  void HybridHashJoinOperator::close() {
+    // unpin the output pages of the spilled buckets if the join is closed
+    // early; only the probe side has pages pinned once open has returned
+    for (unsigned int i = 0; i < this->bucketPageNos.size(); i++) {
+      if (this->bucketPageNos[i] != Page::INVALID_NUMBER) {
+        File *bucketFile = this->isBuildLeft ?
+            this->rightBucketFiles[i] : this->leftBucketFiles[i];
+        this->bufMgr->unPinPage(bucketFile, this->bucketPageNos[i], true);
+        this->bucketPageNos[i] = Page::INVALID_NUMBER;
+      }
+    }
+    this->isProbeOpen = false;
+    BucketJoinOperator::close();
+  }
+
+  ParallelHashJoinOperator::ParallelHashJoinOperator(File &leftTableFile,
+      File &rightTableFile, const TableSchema &leftTableSchema,
+      const TableSchema &rightTableSchema, const Catalog *catalog, BufMgr *bufMgr) :
+      JoinOperator(leftTableFile, rightTableFile, leftTableSchema, rightTableSchema, catalog,
+          bufMgr), numWorkers(max((int) std::thread::hardware_concurrency(), 1)),
+          numActiveWorkers(0), nextMorsel(0), numMorsels(0), maxWorkerMorsels(0),
+          hashTablesBudget(0), hashTablesSize(0), isBuildOverBudget(false), probeResultFile(NULL),
+          isProbed(false), workerTask(NULL), numWorkerTasks(0), numBusyWorkers(0),
+          isWorkerStopping(false) {
+    // nothing
+  }
+
+  vector<PageId> ParallelHashJoinOperator::getPageNos(File &file) {
+    vector<PageId> pageNos;
+    for (FileIterator itFile = file.begin(); itFile != file.end(); itFile++) {
+      pageNos.push_back(itFile.page_number());
+    }
+    return pageNos;
+  }
+
+  int ParallelHashJoinOperator::getPartition(const string &key) const {
+    std::hash<string> strHash;
+    return strHash(key) % this->numActiveWorkers;
+  }
+
+  bool ParallelHashJoinOperator::claimMorsel(const vector<PageId> &pageNos,
+      unsigned int &first, unsigned int &last) {
+    first = this->nextMorsel.fetch_add(MORSEL_PAGES);
+    if (first >= pageNos.size()) {
+      return false;
+    }
+    last = min((std::size_t) (first + MORSEL_PAGES), pageNos.size());
+    return true;
+  }
+
+  void ParallelHashJoinOperator::startWorkers() {
+    this->stopWorkers();
+    this->isWorkerStopping = false;
+    this->numWorkerTasks = 0;
+    for (int i = 0; i < this->numActiveWorkers; i++) {
+      this->workerThreads.push_back(std::thread(&ParallelHashJoinOperator::runWorker, this, i));
+    }
+  }
+
+  void ParallelHashJoinOperator::stopWorkers() {
+    if (this->workerThreads.empty() == true) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> guard(this->workerLatch);
+      this->isWorkerStopping = true;
+    }
+    this->workerCondition.notify_all();
+    for (unsigned int i = 0; i < this->workerThreads.size(); i++) {
+      this->workerThreads[i].join();
+    }
+    this->workerThreads.clear();
+  }
+
+  void ParallelHashJoinOperator::runWorker(int worker) {
+    std::unique_lock<std::mutex> guard(this->workerLatch);
+    unsigned int numTasks = 0;
+    while (true) {
+      this->workerCondition.wait(guard, [this, numTasks]() {
+        return this->isWorkerStopping == true || this->numWorkerTasks != numTasks;
+      });
+      if (this->isWorkerStopping == true) {
+        return;
+      }
+      numTasks = this->numWorkerTasks;
+      void (ParallelHashJoinOperator::*task)(int) = this->workerTask;
+      guard.unlock();
+      std::exception_ptr error;
+      try {
+        (this->*task)(worker);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      guard.lock();
+      if (error != nullptr && this->workerError == nullptr) {
+        this->workerError = error;
+      }
+      if (--this->numBusyWorkers == 0) {
+        this->workerDoneCondition.notify_one();
+      }
+    }
+  }
+
+  void ParallelHashJoinOperator::runWorkers(void (ParallelHashJoinOperator::*task)(int)) {
+    std::unique_lock<std::mutex> guard(this->workerLatch);
+    this->workerTask = task;
+    this->numBusyWorkers = this->numActiveWorkers;
+    this->workerError = nullptr;
+    this->numWorkerTasks++;
+    this->workerCondition.notify_all();
+    this->workerDoneCondition.wait(guard, [this]() {
+      return this->numBusyWorkers == 0;
+    });
+    if (this->workerError != nullptr) {
+      std::exception_ptr error = this->workerError;
+      this->workerError = nullptr;
+      guard.unlock();
+      std::rethrow_exception(error);
+    }
+  }
+
+  void ParallelHashJoinOperator::buildWorker(int worker) {
+    File *file = &(this->leftScan->getFile());
+    vector<vector<pair<string, string>>> &partitions = this->workerPartitions[worker];
+    BufferRing ring;
+    unsigned int first;
+    unsigned int last;
+    while (this->claimMorsel(this->buildPageNos, first, last)) {
+      for (unsigned int i = first; i < last; i++) {
+        Page *page;
+        this->bufMgr->readPage(file, this->buildPageNos[i], page, &ring);
+        this->workerNumIOs[worker]++;
+        for (PageIterator itPage = page->begin(); itPage != page->end(); itPage++) {
+          RecordView record = itPage.getRecordView();
+          string key = getJoinKey(TupleView(this->leftTupleLayout, record),
+              this->joinAttrsIDLeft);
+          int partition = this->getPartition(key);
+          partitions[partition].push_back(pair<string, string>(key, record.str()));
+        }
+        this->bufMgr->unPinPage(file, this->buildPageNos[i], false);
+      }
+    }
+  }
+
+  void ParallelHashJoinOperator::mergeWorker(int partition) {
+    JoinHashTable &hashTable = this->hashTables[partition];
+    for (int i = 0; i < this->numActiveWorkers; i++) {
+      const vector<pair<string, string>> &tuples = this->workerPartitions[i][partition];
+      for (unsigned int j = 0; j < tuples.size(); j++) {
+        std::size_t growth = hashTable.getSizeAfterInsert(tuples[j].first, tuples[j].second)
+            - hashTable.getSize();
+        if (this->hashTablesSize.fetch_add(growth) + growth > this->hashTablesBudget) {
+          this->isBuildOverBudget = true;
+          return;
+        }
+        hashTable.insert(tuples[j].first, tuples[j].second);
+      }
+    }
+  }
+
+  void ParallelHashJoinOperator::probeWorker(int worker) {
+    File *file = &(this->rightScan->getFile());
+    PageId resultPageNo = Page::INVALID_NUMBER;
+    Page *resultPage = NULL;
+    unsigned int first;
+    unsigned int last;
+    vector<PageId> morselPageNos;
+    vector<Page*> morselPages;
+    for (unsigned int numWorkerMorsels = 0; (this->maxWorkerMorsels == 0
+        || numWorkerMorsels < this->maxWorkerMorsels)
+        && this->claimMorsel(this->probePageNos, first, last); numWorkerMorsels++) {
+      // the pages of the morsel are read at the same time
+      morselPageNos.assign(this->probePageNos.begin() + first,
+          this->probePageNos.begin() + last);
+      this->bufMgr->readPages(file, morselPageNos, morselPages);
+      this->workerNumIOs[worker] += morselPageNos.size();
+      for (unsigned int i = 0; i < morselPages.size(); i++) {
+        Page *page = morselPages[i];
+        for (PageIterator itPage = page->begin(); itPage != page->end(); itPage++) {
+          RecordView record = itPage.getRecordView();
+          string key = getJoinKey(TupleView(this->rightTupleLayout, record),
+              this->joinAttrsIDRight);
+          const JoinHashTable &hashTable = this->hashTables[this->getPartition(key)];
+          for (JoinHashTable::MatchIterator it = hashTable.find(key); it != hashTable.end();
+              ++it) {
+            string joinedTuple = this->joinTuples(*it, record);
+            if (this->probeResultFile == NULL) {
+              this->workerResultTuples[worker].push_back(joinedTuple);
+            } else if (appendRecord(this->bufMgr, this->probeResultFile, joinedTuple,
+                resultPageNo, resultPage)) {
+              this->workerNumIOs[worker]++;
+            }
+            this->workerNumResultTuples[worker]++;
+          }
+        }
+        this->bufMgr->unPinPage(file, morselPageNos[i], false);
+      }
+    }
+    if (resultPageNo != Page::INVALID_NUMBER) {
+      this->bufMgr->unPinPage(this->probeResultFile, resultPageNo, true);
+    }
+  }
+
+  void ParallelHashJoinOperator::collectWorkerIOs() {
+    for (unsigned int i = 0; i < this->workerNumIOs.size(); i++) {
+      this->numIOs += this->workerNumIOs[i];
+      this->workerNumIOs[i] = 0;
+    }
+  }
+
+  void ParallelHashJoinOperator::printRunningStats() const {
+    JoinOperator::printRunningStats();
+    cout << "# Workers: " << this->numActiveWorkers << endl;
+    cout << "# Morsels: " << this->numMorsels << endl;
+  }
+
+  void ParallelHashJoinOperator::open() {
+    std::cout << "... executing parallel hash join" << "\n";
+    JoinOperator::open();
+
+    // the hash tables keep the join key, an entry and slots besides each left
+    // tuple, so they are planned at four times the pages of the left table,
+    // and a probe worker pins a morsel of its input and a result page
+    this->buildPageNos = getPageNos(this->leftScan->getFile());
+    this->probePageNos = getPageNos(this->rightScan->getFile());
+    this->numActiveWorkers = max(min(this->numWorkers,
+        (this->numAvailableBufPages - 4 * (int) this->buildPageNos.size())
+            / (int) (MORSEL_PAGES + 1)), 1);
+    int numTablePages = this->numAvailableBufPages
+        - (int) (MORSEL_PAGES + 1) * this->numActiveWorkers;
+    this->numMorsels = (this->buildPageNos.size() + MORSEL_PAGES - 1) / MORSEL_PAGES
+        + (this->probePageNos.size() + MORSEL_PAGES - 1) / MORSEL_PAGES;
+    this->workerNumResultTuples.assign(this->numActiveWorkers, 0);
+    this->workerNumIOs.assign(this->numActiveWorkers, 0);
+    this->workerResultTuples.assign(this->numActiveWorkers, vector<string>());
+    this->startWorkers();
+
+    // build stage, partitioning the left table, then building the hash table
+    // of each partition
+    this->workerPartitions.assign(this->numActiveWorkers,
+        vector<vector<pair<string, string>>>(this->numActiveWorkers));
+    this->hashTables.assign(this->numActiveWorkers, JoinHashTable());
+    this->nextMorsel = 0;
+    this->runWorkers(&ParallelHashJoinOperator::buildWorker);
+
+    // the hash tables share the pages left by the probe workers, counted the
+    // way getSize() counts them, so that entry and slot overhead in one table
+    // can use pages another table leaves free; the raw bytes of the left
+    // tuples are a lower bound on that size, so a build that is over the
+    // budget by them alone is not merged at all
+    std::size_t buildSize = 0;
+    for (int i = 0; i < this->numActiveWorkers; i++) {
+      for (int j = 0; j < this->numActiveWorkers; j++) {
+        const vector<pair<string, string>> &tuples = this->workerPartitions[i][j];
+        for (unsigned int k = 0; k < tuples.size(); k++) {
+          buildSize += tuples[k].first.size() + tuples[k].second.size();
+        }
+      }
+    }
+    this->hashTablesBudget = max(numTablePages, 0) * Page::SIZE;
+    this->hashTablesSize = 0;
+    for (int j = 0; j < this->numActiveWorkers; j++) {
+      this->hashTablesSize += this->hashTables[j].getSize();
+    }
+    this->isBuildOverBudget = buildSize + this->hashTablesSize > this->hashTablesBudget;
+    if (this->isBuildOverBudget == false) {
+      this->runWorkers(&ParallelHashJoinOperator::mergeWorker);
+    }
+    this->workerPartitions.clear();
+    this->collectWorkerIOs();
+    if (this->isBuildOverBudget == true) {
+      this->hashTables.clear();
+      throw BufferExceededException();
+    }
+
+    // the hash tables, and a morsel of the right table and a result page per
+    // worker
+    std::size_t tableSize = 0;
+    for (int i = 0; i < this->numActiveWorkers; i++) {
+      tableSize += this->hashTables[i].getSize();
+    }
+    this->numUsedBufPages = (tableSize + Page::SIZE - 1) / Page::SIZE
+        + (MORSEL_PAGES + 1) * this->numActiveWorkers;
+    this->nextMorsel = 0;
+    this->isProbed = false;
+  }
+
+  bool ParallelHashJoinOperator::fill() {
+    if (this->isProbed) {
+      return false;
+    }
+
+    // probe stage, a morsel per worker at a time, keeping the joined tuples
+    // of the workers in memory until they are read
+    this->probeResultFile = NULL;
+    this->maxWorkerMorsels = 1;
+    this->runWorkers(&ParallelHashJoinOperator::probeWorker);
+    this->maxWorkerMorsels = 0;
+    if (this->nextMorsel >= this->probePageNos.size()) {
+      this->isProbed = true;
+    }
+    this->collectWorkerIOs();
+    for (int i = 0; i < this->numActiveWorkers; i++) {
+      this->resultTuples.insert(this->resultTuples.end(), this->workerResultTuples[i].begin(),
+          this->workerResultTuples[i].end());
+      this->workerResultTuples[i].clear();
+    }
+    return true;
+  }
+
+  void ParallelHashJoinOperator::close() {
+    this->stopWorkers();
+    this->hashTables.clear();
+    this->workerResultTuples.clear();
+    JoinOperator::close();
+  }
+
+  bool ParallelHashJoinOperator::execute(int numAvailableBufPages, File &resultFile) {
     if (this->isComplete)
       return true;
 
-    this->numResultTuples = 0;
-    this->numUsedBufPages = 0;
-    this->numIOs = 0;
+    this->numAvailableBufPages = numAvailableBufPages;
+    this->tempFilePrefix = resultFile.filename();
+    this->open();
+
+    // probe stage, each worker appending to its own result pages
+    this->probeResultFile = &resultFile;
+    this->runWorkers(&ParallelHashJoinOperator::probeWorker);
+    this->probeResultFile = NULL;
+    this->isProbed = true;
+    this->collectWorkerIOs();
+    for (int i = 0; i < this->numActiveWorkers; i++) {
+      this->numResultTuples += this->workerNumResultTuples[i];
+    }
+    this->close();
+    this->bufMgr->flushFile(&resultFile);
 
-    // NO NEED TO DO
+    // the pages of the input tables read through the buffer pool must not
+    // outlive their File objects
+    this->bufMgr->flushFile(&(this->leftScan->getFile()));
+    this->bufMgr->flushFile(&(this->rightScan->getFile()));
 
     this->isComplete = true;
     return true;
@@ -9,302 +9,2306 @@
 #include "buffer.h"
 #include "catalog.h"
 #include "file.h"
+#include "file_iterator.h"
+#include "page_iterator.h"
 #include "schema.h"
 #include "storage.h"
+#include "tuple.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 namespace badgerdb {
 
   /**
-   * Table scanner
+   * Operator of a query plan in the iterator model. The consumer calls open(),
+   * then next() until it returns false, then close(). Tuples are produced on
+   * demand, so an operator can take its input straight from another operator
+   * without the tuples being written to a file in between. An operator that
+   * has been closed may be opened again, which produces its tuples once more.
    */
-  class TableScanner {
-    private:
+  class Operator {
+    public:
       /**
-       * Table filename
+       * Destructor
        */
-      File &tableFile;
+      virtual ~Operator() {
+        // nothing
+      }
 
       /**
-       * Table schema
+       * Get the schema of the tuples produced
        */
-      const TableSchema &tableSchema;
+      virtual const TableSchema& getSchema() const = 0;
 
       /**
-       * Buffer pool manager
+       * Estimate the number of pages the tuples produced fill
+       * @return If the estimate is unknown, return -1
        */
-      BufMgr *bufMgr;
+      virtual int estimateNumPages() const = 0;
 
-    public:
-      TableScanner(File &tableFile, const TableSchema &tableSchema, BufMgr *bufMgr) :
-          tableFile(tableFile), tableSchema(tableSchema), bufMgr(bufMgr) {
-        // nothing
-      }
+      /**
+       * Prepare to produce the tuples
+       */
+      virtual void open() = 0;
 
-      ~TableScanner() {
-        // nothing
-      }
+      /**
+       * Produce the next tuple. The tuple is not copied; its view is valid
+       * until the next call of next() or close().
+       * @return If there is no tuple left, return false
+       */
+      virtual bool next(RecordView &tuple) = 0;
 
       /**
-       * Print tuples in the table
+       * Produce the next tuples into a batch, replacing what it holds. The
+       * tuples are copied into the batch, so a consumer of batches makes one
+       * call per batch instead of one per tuple.
+       * @return If there is no tuple left, return false
        */
-      void print() const;
+      virtual bool nextBatch(TupleBatch &batch);
+
+      /**
+       * Release the resources held, e.g. pinned pages and temporary files
+       */
+      virtual void close() = 0;
   };
 
   /**
-   * Join Operator
+   * Operator producing the tuples of a table. The pages are read through the
+   * buffer pool and only the page being read is pinned.
    */
-  class JoinOperator {
-    protected:
+  class TableScanOperator: public Operator {
+    private:
       /**
-       * Data file of the left table
+       * Table file
        */
-      File &leftTableFile;
+      File &tableFile;
 
       /**
-       * Data file of the right table
+       * Table schema
        */
-      File &rightTableFile;
+      const TableSchema &tableSchema;
 
       /**
-       * Schema of the left table
+       * Buffer pool manager
        */
-      const TableSchema &leftTableSchema;
+      BufMgr *bufMgr;
 
       /**
-       * Schema of the right table
+       * Is the table read through a buffer ring? A ring keeps a scan from
+       * evicting other pages, but the pages of a table scanned many times are
+       * better kept in the buffer pool.
        */
-      const TableSchema &rightTableSchema;
+      bool isRingUsed;
 
       /**
-       * Schema of the result table
+       * Ring the table is read through
        */
-      TableSchema resultTableSchema;
+      BufferRing ring;
 
       /**
-       * System catalog
+       * Position in the table
        */
-      const Catalog *catalog;
+      FileIterator itFile;
 
       /**
-       * Buffer pool manager
+       * Page currently pinned, or Page::INVALID_NUMBER
        */
-      BufMgr *bufMgr;
+      PageId pageNo;
 
       /**
-       * Is the executor completed
+       * The pinned page
        */
-      bool isComplete;
+      Page *page;
 
       /**
-       * Number of result tuples
+       * Position in the pinned page
        */
-      int numResultTuples;
+      PageIterator itPage;
 
       /**
-       * Number of buffer pages actually used by the executor
+       * Number of pages read
        */
-      int numUsedBufPages;
+      int numReadPages;
 
       /**
-       * Number of I/Os carried out by the executor
+       * Unpin the current page and pin the next one
+       * @return If there is no page left, return false
        */
-      int numIOs;
+      bool readNextPage();
 
     public:
       /**
        * Constructor
        */
-      JoinOperator(File &leftTableFile, File &rightTableFile,
-          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
-          const Catalog *catalog, BufMgr *bufMgr);
+      TableScanOperator(File &tableFile, const TableSchema &tableSchema, BufMgr *bufMgr,
+          bool isRingUsed = true);
 
       /**
        * Destructor
        */
-      ~JoinOperator() {
-        // nothing
+      ~TableScanOperator() {
+        this->close();
+      }
+
+      const TableSchema& getSchema() const {
+        return tableSchema;
       }
 
+      int estimateNumPages() const;
+
+      void open();
+
+      bool next(RecordView &tuple);
+
+      bool nextBatch(TupleBatch &batch);
+
+      void close();
+
       /**
-       * Is the algorithm complete?
+       * Get the table file
        */
-      bool isCompleted() const {
-        return isComplete;
+      File& getFile() const {
+        return tableFile;
       }
 
       /**
-       * Get the operator's name
+       * Get the page of the last tuple produced
        */
-      virtual string getOperatorName() const {
-        return "JOIN";
+      PageId getPageNumber() const {
+        return pageNo;
       }
 
       /**
-       * Print the running statistics of the executor
+       * Get number of pages read, over all the scans
        */
-      virtual void printRunningStats() const;
+      int getNumReadPages() const {
+        return numReadPages;
+      }
+  };
 
+  /**
+   * Sink writing the tuples produced by an operator into a file
+   */
+  class FileSink {
+    private:
       /**
-       * Execute the join algorithm
-       * @return If succeeded, return true
+       * File to write
        */
-      virtual bool execute(int numAvailableBufPages, File &resultFile) = 0;
+      File &file;
 
       /**
-       * Get the schema of the result table
+       * Buffer pool manager
        */
-      const TableSchema& getResultTableSchema() const {
-        return resultTableSchema;
-      }
+      BufMgr *bufMgr;
 
       /**
-       * Get number of result tuples
+       * Number of tuples written
        */
-      int getNumResultTuples() const {
-        return numResultTuples;
-      }
+      int numTuples;
 
       /**
-       * Get number of buffer pages used by the executor
+       * Number of pages written
        */
-      int getNumUsedBufPages() const {
-        return numUsedBufPages;
-      }
+      int numPages;
 
+    public:
       /**
-       * Get number of I/Os carried out by the executor
+       * Constructor
        */
-      int getNumIOs() const {
-        return numIOs;
+      FileSink(File &file, BufMgr *bufMgr) :
+          file(file), bufMgr(bufMgr), numTuples(0), numPages(0) {
+        // nothing
       }
 
       /**
-       * Create the result schema using the input schemas
+       * Run an operator and append all its tuples to the file. The pages
+       * written are flushed out of the buffer pool.
        */
-      static TableSchema createResultTableSchema(const TableSchema &leftTableSchema,
-          const TableSchema &rightTableSchema);
-  };
+      void write(Operator &input);
 
-  class OnePassJoinOperator: public JoinOperator {
-    public:
       /**
-       * Constructor
+       * Get number of tuples written
        */
-      OnePassJoinOperator(File &leftTableFile, File &rightTableFile,
-          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
-          const Catalog *catalog, BufMgr *bufMgr) :
-          JoinOperator(leftTableFile, rightTableFile, leftTableSchema, rightTableSchema,
-              catalog, bufMgr) {
-        // nothing
+      int getNumTuples() const {
+        return numTuples;
       }
 
       /**
-       * Destructor
+       * Get number of pages written
        */
-      ~OnePassJoinOperator() {
-        // nothing
+      int getNumPages() const {
+        return numPages;
       }
+  };
 
+  /**
+   * Table scanner
+   */
+  class TableScanner {
+    private:
       /**
-       * Get oprator's name (overrided)
+       * Table filename
        */
-      string getOperatorName() const {
-        return "ONE_PASS_JOIN";
+      File &tableFile;
+
+      /**
+       * Table schema
+       */
+      const TableSchema &tableSchema;
+
+      /**
+       * Buffer pool manager
+       */
+      BufMgr *bufMgr;
+
+    public:
+      TableScanner(File &tableFile, const TableSchema &tableSchema, BufMgr *bufMgr) :
+          tableFile(tableFile), tableSchema(tableSchema), bufMgr(bufMgr) {
+        // nothing
       }
 
-      bool execute(int numAvailableBufPages, File &resultFile);
+      ~TableScanner() {
+        // nothing
+      }
+
+      /**
+       * Print tuples in the table
+       */
+      void print() const;
   };
 
-  class NestedLoopJoinOperator: public JoinOperator {
+  /**
+   * Sequential reader of a list of pages of a file, e.g. a sorted run. Pages
+   * are read through the buffer pool and only the page being read is pinned.
+   */
+  class RunReader {
+    private:
+      /**
+       * Buffer pool manager
+       */
+      BufMgr *bufMgr;
+
+      /**
+       * File to read
+       */
+      File *file;
+
+      /**
+       * Pages to read, in order
+       */
+      vector<PageId> pages;
+
+      /**
+       * Index of the next page to read in pages
+       */
+      unsigned int nextPageIndex;
+
+      /**
+       * Page currently pinned, or Page::INVALID_NUMBER
+       */
+      PageId pageNo;
+
+      /**
+       * The pinned page
+       */
+      Page *page;
+
+      /**
+       * Position in the pinned page
+       */
+      PageIterator itPage;
+
+      /**
+       * Number of pages read
+       */
+      int numReadPages;
+
     public:
       /**
        * Constructor
        */
-      NestedLoopJoinOperator(File &leftTableFile, File &rightTableFile,
-          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
-          const Catalog *catalog, BufMgr *bufMgr) :
-          JoinOperator(leftTableFile, rightTableFile, leftTableSchema, rightTableSchema,
-              catalog, bufMgr) {
-        // nothing
-      }
+      RunReader(BufMgr *bufMgr, File *file, const vector<PageId> &pages);
 
       /**
-       * Destructor
+       * Read the next record. The record is not copied; its view is valid
+       * until the next call of next() or close().
+       * @return If there is no record left, return false
        */
-      ~NestedLoopJoinOperator() {
-        // nothing
-      }
+      bool next(RecordView &record);
 
       /**
-       * Get oprator's name (overrided)
+       * Unpin the page being read, if any
        */
-      string getOperatorName() const {
-        return "NESTED_LOOP_JOIN";
-      }
+      void close();
 
-      bool execute(int numAvailableBufPages, File &resultFile);
+      /**
+       * Get number of pages read
+       */
+      int getNumReadPages() const {
+        return numReadPages;
+      }
   };
 
   /**
-   * Bucket Id type
+   * Loser tree selecting the smallest of the current keys of k sorted runs.
+   * A run whose key is exhausted never wins while there are other runs left.
+   * Ties are won by the run with the smaller index, so merging is stable.
    */
-  typedef std::uint32_t BucketId;
-
-  class GraceHashJoinOperator: public JoinOperator {
+  class LoserTree {
     private:
       /**
-       * Number of buckets
+       * Current key of each run
        */
-      int numBuckets;
+      const vector<string> &keys;
 
       /**
-       * Hash function from key to bucket Id
+       * Is each run exhausted?
        */
-      BucketId hash(const string &key) const;
+      const vector<bool> &isExhausted;
+
+      /**
+       * Number of runs
+       */
+      int numRuns;
+
+      /**
+       * Loser of the match at each inner node; node 1 is the root and the
+       * leaf of run i is node numRuns + i
+       */
+      vector<int> tree;
+
+      /**
+       * Run holding the smallest key
+       */
+      int winner;
+
+      /**
+       * Does run a come before run b?
+       */
+      bool isLess(int a, int b) const;
+
+      /**
+       * Play the matches of the subtree rooted at node
+       * @return Winner of the subtree
+       */
+      int build(int node);
 
     public:
       /**
        * Constructor
        */
-      GraceHashJoinOperator(File &leftTableFile, File &rightTableFile,
-          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
-          const Catalog *catalog, BufMgr *bufMgr) :
-          JoinOperator(leftTableFile, rightTableFile, leftTableSchema, rightTableSchema,
-              catalog, bufMgr) {
-        // nothing
-      }
+      LoserTree(const vector<string> &keys, const vector<bool> &isExhausted);
 
       /**
-       * Destructor
+       * Get the run holding the smallest key
        */
-      ~GraceHashJoinOperator() {
-        // nothing
+      int getWinner() const {
+        return winner;
       }
 
       /**
-       * Get oprator's name (overrided)
+       * Replay the matches on the path of the winner after its key changed
        */
-      string getOperatorName() const {
-        return "GRACE_HASH_JOIN";
-      }
+      void replay();
+  };
 
+  /**
+   * External merge sort of the tuples of a table on some of its attributes.
+   * Runs are generated in numAvailableBufPages pages of memory and merged
+   * numAvailableBufPages - 1 at a time with a loser tree.
+   */
+  class ExternalSort {
+    private:
       /**
-       * Print running statistics (overrided)
+       * A sorted run in a temporary file
        */
-      void printRunningStats() const {
-        JoinOperator::printRunningStats();
-        cout << "# Buckets: " << numBuckets << endl;
-      }
+      struct SortRun {
+          /**
+           * File of the run
+           */
+          File *file;
+
+          /**
+           * Pages of the run, in order
+           */
+          vector<PageId> pages;
+      };
 
       /**
-       * Get number of buckets
+       * Schema of the table
        */
-      int getNumBuckets() const {
-        return numBuckets;
-      }
+      const TableSchema &tableSchema;
+
+      /**
+       * Tuple layout of the table
+       */
+      TupleLayout tupleLayout;
+
+      /**
+       * Ids of the attributes to sort on
+       */
+      vector<int> sortAttrsID;
+
+      /**
+       * Buffer pool manager
+       */
+      BufMgr *bufMgr;
 
+      /**
+       * Number of runs generated
+       */
+      int numRuns;
+
+      /**
+       * Number of passes over the data
+       */
+      int numPasses;
+
+      /**
+       * Number of I/Os carried out
+       */
+      int numIOs;
+
+      /**
+       * Number of temporary files created, used to name them
+       */
+      int numTempFiles;
+
+      /**
+       * Sort the tuples in memory and write them to a file
+       */
+      void writeRun(vector<pair<string, string>> &tuples, File *file,
+          vector<PageId> &pages);
+
+      /**
+       * Merge sorted runs into a file
+       */
+      void mergeRuns(const vector<SortRun> &runs, File *file, vector<PageId> &pages);
+
+      /**
+       * Create a temporary file for a run
+       */
+      SortRun createRun(const File &outputFile);
+
+    public:
+      /**
+       * Constructor
+       */
+      ExternalSort(const TableSchema &tableSchema, const vector<int> &sortAttrsID,
+          BufMgr *bufMgr) :
+          tableSchema(tableSchema), tupleLayout(tableSchema), sortAttrsID(sortAttrsID),
+              bufMgr(bufMgr), numRuns(0), numPasses(0), numIOs(0), numTempFiles(0) {
+        // nothing
+      }
+
+      /**
+       * Sort the tuples produced by an operator into the output file
+       * @return Pages of the output file, in sorted order
+       */
+      vector<PageId> sort(Operator &input, int numAvailableBufPages, File &outputFile);
+
+      /**
+       * Get the key a tuple is sorted on. Keys compare as strings in the order
+       * of the attribute values.
+       */
+      string getSortKey(const RecordView &record) const;
+
+      /**
+       * Get number of runs generated
+       */
+      int getNumRuns() const {
+        return numRuns;
+      }
+
+      /**
+       * Get number of passes over the data
+       */
+      int getNumPasses() const {
+        return numPasses;
+      }
+
+      /**
+       * Get number of I/Os carried out
+       */
+      int getNumIOs() const {
+        return numIOs;
+      }
+  };
+
+  /**
+   * Borrowed view of the bytes of a join key, e.g. a string built by
+   * getJoinKey() or a key of TupleBatch::getKeys()
+   */
+  typedef RecordView KeyView;
+
+  /**
+   * In-memory hash table of the tuples of a join input on their join keys.
+   * The keys and tuples are copied back to back into two arenas, and an
+   * open-addressing table over the hashes of the keys holds the first and
+   * the last tuple of each key, the tuples of a key being chained in the
+   * order they were inserted. A lookup returns an iterator over the tuples of
+   * a key, which are not copied. The table may be given a budget of bytes,
+   * counting the arenas, the tuples and the slots.
+   */
+  class JoinHashTable {
+    private:
+      /**
+       * Marks the end of a chain or an empty slot
+       */
+      static const uint32_t NO_ENTRY = 0xffffffffu;
+
+      /**
+       * Tuple in the hash table
+       */
+      struct Entry {
+        /**
+         * Hash of the join key
+         */
+        std::size_t hash;
+
+        /**
+         * Offset of the join key in keyData
+         */
+        uint32_t keyOffset;
+
+        /**
+         * Number of bytes of the join key
+         */
+        uint32_t keyLength;
+
+        /**
+         * Offset of the tuple in tupleData
+         */
+        uint32_t tupleOffset;
+
+        /**
+         * Number of bytes of the tuple
+         */
+        uint32_t tupleLength;
+
+        /**
+         * Next tuple with the same key, or NO_ENTRY
+         */
+        uint32_t next;
+      };
+
+      /**
+       * Slot of the open-addressing table
+       */
+      struct Slot {
+        /**
+         * First tuple of the key, or NO_ENTRY if the slot is empty
+         */
+        uint32_t head;
+
+        /**
+         * Last tuple of the key
+         */
+        uint32_t tail;
+      };
+
+      /**
+       * Max number of bytes, 0 for no budget
+       */
+      std::size_t budget;
+
+      /**
+       * Join keys, back to back
+       */
+      string keyData;
+
+      /**
+       * Tuples, back to back
+       */
+      string tupleData;
+
+      /**
+       * Tuples, in the order they were inserted
+       */
+      vector<Entry> entries;
+
+      /**
+       * Slots, twice as many as the keys at least; their number is a power of 2
+       */
+      vector<Slot> slots;
+
+      /**
+       * Number of distinct keys
+       */
+      uint32_t numKeys;
+
+      /**
+       * Find the slot of a key, or the empty slot it would take
+       */
+      uint32_t findSlot(const KeyView &key, std::size_t hash) const;
+
+      /**
+       * Double the number of slots
+       */
+      void grow();
+
+    public:
+      /**
+       * Iterator over the tuples of a join key
+       */
+      class MatchIterator {
+        private:
+          /**
+           * Hash table iterated
+           */
+          const JoinHashTable *table;
+
+          /**
+           * Current tuple, or NO_ENTRY past the last one
+           */
+          uint32_t entry;
+
+        public:
+          /**
+           * Constructor of an iterator past the last tuple
+           */
+          MatchIterator() :
+              table(NULL), entry(NO_ENTRY) {
+            // nothing
+          }
+
+          /**
+           * Constructor
+           */
+          MatchIterator(const JoinHashTable *table, uint32_t entry) :
+              table(table), entry(entry) {
+            // nothing
+          }
+
+          /**
+           * Move to the next tuple of the key
+           */
+          MatchIterator& operator++() {
+            entry = table->entries[entry].next;
+            return *this;
+          }
+
+          bool operator==(const MatchIterator &rhs) const {
+            return entry == rhs.entry;
+          }
+
+          bool operator!=(const MatchIterator &rhs) const {
+            return entry != rhs.entry;
+          }
+
+          /**
+           * Get the bytes of the current tuple
+           */
+          RecordView operator*() const {
+            const Entry &current = table->entries[entry];
+            return RecordView(table->tupleData.data() + current.tupleOffset,
+                current.tupleLength);
+          }
+      };
+
+      /**
+       * Constructor
+       * @param budget Max number of bytes, 0 for no budget
+       */
+      JoinHashTable(std::size_t budget = 0);
+
+      /**
+       * Hash a join key
+       */
+      static std::size_t hashKey(const KeyView &key);
+
+      /**
+       * Set the max number of bytes, 0 for no budget
+       */
+      void setBudget(std::size_t budget) {
+        this->budget = budget;
+      }
+
+      /**
+       * Remove all tuples, keeping the budget
+       */
+      void clear();
+
+      /**
+       * Add a copy of a tuple with its join key. The hash is the one of the key.
+       */
+      void insert(const KeyView &key, std::size_t hash, const RecordView &tuple);
+
+      /**
+       * Add a copy of a tuple with its join key
+       */
+      void insert(const KeyView &key, const RecordView &tuple) {
+        insert(key, hashKey(key), tuple);
+      }
+
+      /**
+       * Find the tuples with a join key. The hash is the one of the key.
+       * @return Iterator over the tuples, equal to end() if there is none
+       */
+      MatchIterator find(const KeyView &key, std::size_t hash) const;
+
+      /**
+       * Find the tuples with a join key
+       * @return Iterator over the tuples, equal to end() if there is none
+       */
+      MatchIterator find(const KeyView &key) const {
+        return find(key, hashKey(key));
+      }
+
+      /**
+       * Get the iterator past the last tuple of any key
+       */
+      MatchIterator end() const {
+        return MatchIterator();
+      }
+
+      /**
+       * Is there no tuple?
+       */
+      bool empty() const {
+        return entries.empty();
+      }
+
+      /**
+       * Get the number of tuples
+       */
+      int getNumTuples() const {
+        return entries.size();
+      }
+
+      /**
+       * Get the number of bytes used
+       */
+      std::size_t getSize() const {
+        return keyData.size() + tupleData.size() + entries.size() * sizeof(Entry)
+            + slots.size() * sizeof(Slot);
+      }
+
+      /**
+       * Has the table reached its budget?
+       */
+      bool isFull() const {
+        return budget != 0 && getSize() >= budget;
+      }
+
+      /**
+       * Can a tuple with a join key be inserted without going over the budget?
+       */
+      bool hasSpaceFor(const KeyView &key, const RecordView &tuple) const {
+        return budget == 0 || getSizeAfterInsert(key, tuple) <= budget;
+      }
+
+      /**
+       * Get the number of bytes used after inserting a tuple with a join key,
+       * counting the slots of the table if the insert makes it grow
+       */
+      std::size_t getSizeAfterInsert(const KeyView &key, const RecordView &tuple) const {
+        std::size_t size = getSize() + key.length + tuple.length + sizeof(Entry);
+        if (2 * (numKeys + 1) > slots.size()) {
+          size += slots.size() * sizeof(Slot);
+        }
+        return size;
+      }
+  };
+
+  /**
+   * In-memory hash table of the tuples of a join input, partitioned on the
+   * radix bits of the hashes of their join keys. The tuples are inserted
+   * first, then build() splits them into partitions of about the partition
+   * size, CACHE_SIZE bytes unless set otherwise, in one pass or, if more
+   * than MAX_BITS_PER_PASS bits are needed, in two passes so that a pass
+   * never writes to more partitions than the TLB reaches at once. Each
+   * partition then gets a small open-addressing table on the remaining hash
+   * bits, so a lookup touches one cache-sized partition instead of walking a
+   * tree.
+   */
+  class RadixHashTable {
+    public:
+      /**
+       * Target number of bytes of the entries of a partition, the size of a
+       * second-level cache
+       */
+      static const std::size_t CACHE_SIZE = 256 * 1024;
+
+      /**
+       * Max number of radix bits of a partitioning pass
+       */
+      static const int MAX_BITS_PER_PASS = 6;
+
+    private:
+      /**
+       * Tuple in the hash table
+       */
+      struct Entry {
+        /**
+         * Hash of the join key
+         */
+        std::size_t hash;
+
+        /**
+         * Offset of the join key in keyData
+         */
+        uint32_t keyOffset;
+
+        /**
+         * Number of bytes of the join key
+         */
+        uint32_t keyLength;
+
+        /**
+         * Offset of the tuple in tupleData
+         */
+        uint32_t tupleOffset;
+
+        /**
+         * Number of bytes of the tuple
+         */
+        uint32_t tupleLength;
+      };
+
+      /**
+       * Marks an empty slot
+       */
+      static const uint32_t EMPTY_SLOT = 0xffffffffu;
+
+      /**
+       * Join keys, back to back
+       */
+      string keyData;
+
+      /**
+       * Tuples, back to back
+       */
+      string tupleData;
+
+      /**
+       * Entries, grouped by partition once built
+       */
+      vector<Entry> entries;
+
+      /**
+       * Target number of bytes of the entries of a partition
+       */
+      std::size_t partitionSize;
+
+      /**
+       * Number of radix bits of each partitioning pass
+       */
+      vector<int> passBits;
+
+      /**
+       * Number of radix bits of all passes
+       */
+      int numBits;
+
+      /**
+       * First entry of each partition, followed by the number of entries
+       */
+      vector<uint32_t> partitionBounds;
+
+      /**
+       * Slots of the tables of all partitions, each holding an entry or
+       * EMPTY_SLOT
+       */
+      vector<uint32_t> slots;
+
+      /**
+       * First slot of the table of each partition
+       */
+      vector<uint32_t> slotOffsets;
+
+      /**
+       * Number of slots of the table of each partition minus 1
+       */
+      vector<uint32_t> slotMasks;
+
+    public:
+      /**
+       * Constructor
+       */
+      RadixHashTable() :
+          partitionSize(CACHE_SIZE), numBits(0) {
+        // nothing
+      }
+
+      /**
+       * Set the target number of bytes of the entries of a partition, for
+       * the tables built from then on
+       */
+      void setPartitionSize(std::size_t partitionSize) {
+        this->partitionSize = partitionSize;
+      }
+
+      /**
+       * Remove all tuples
+       */
+      void clear();
+
+      /**
+       * Add a copy of a tuple with its join key. No tuple can be inserted
+       * once the table is built.
+       */
+      void insert(const KeyView &key, const RecordView &tuple);
+
+      /**
+       * Partition the tuples and build the table of each partition
+       */
+      void build();
+
+      /**
+       * Get the partition of the hash of a join key
+       */
+      uint32_t getPartition(std::size_t hash) const {
+        uint32_t partition = 0;
+        int shift = 0;
+        for (unsigned int i = 0; i < passBits.size(); i++) {
+          partition = (partition << passBits[i])
+              | ((hash >> shift) & ((1u << passBits[i]) - 1));
+          shift += passBits[i];
+        }
+        return partition;
+      }
+
+      /**
+       * Add the tuples with a join key to a list. The hash is the one of the key.
+       */
+      void find(const KeyView &key, std::size_t hash, vector<RecordView> &tuples) const;
+
+      /**
+       * Get the number of partitions
+       */
+      int getNumPartitions() const {
+        return 1 << numBits;
+      }
+
+      /**
+       * Get the number of partitioning passes
+       */
+      int getNumPasses() const {
+        return passBits.size();
+      }
+
+      /**
+       * Get the number of tuples
+       */
+      int getNumTuples() const {
+        return entries.size();
+      }
+
+      /**
+       * Get the number of bytes used
+       */
+      std::size_t getSize() const {
+        return keyData.size() + tupleData.size() + entries.size() * sizeof(Entry)
+            + slots.size() * sizeof(uint32_t);
+      }
+  };
+
+  /**
+   * Join Operator. The natural join of two input operators is itself an
+   * operator, producing its result tuples on demand.
+   */
+  class JoinOperator: public Operator {
+    protected:
+      /**
+       * Scan of the left table, if the join was created on the table files
+       */
+      TableScanOperator *leftScan;
+
+      /**
+       * Scan of the right table, if the join was created on the table files
+       */
+      TableScanOperator *rightScan;
+
+      /**
+       * Left input
+       */
+      Operator *leftInput;
+
+      /**
+       * Right input
+       */
+      Operator *rightInput;
+
+      /**
+       * Schema of the left table
+       */
+      const TableSchema &leftTableSchema;
+
+      /**
+       * Schema of the right table
+       */
+      const TableSchema &rightTableSchema;
+
+      /**
+       * Schema of the result table
+       */
+      TableSchema resultTableSchema;
+
+      /**
+       * Tuple layout of the left table
+       */
+      TupleLayout leftTupleLayout;
+
+      /**
+       * Tuple layout of the right table
+       */
+      TupleLayout rightTupleLayout;
+
+      /**
+       * Tuple layout of the result table
+       */
+      TupleLayout resultTupleLayout;
+
+      /**
+       * System catalog
+       */
+      const Catalog *catalog;
+
+      /**
+       * Buffer pool manager
+       */
+      BufMgr *bufMgr;
+
+      /**
+       * Number of buffer pages the join may use
+       */
+      int numAvailableBufPages;
+
+      /**
+       * Prefix of the names of the temporary files
+       */
+      string tempFilePrefix;
+
+      /**
+       * Ids of the join attributes in the left table
+       */
+      vector<int> joinAttrsIDLeft;
+
+      /**
+       * Ids of the join attributes in the right table
+       */
+      vector<int> joinAttrsIDRight;
+
+      /**
+       * Result tuples produced and not consumed yet
+       */
+      vector<string> resultTuples;
+
+      /**
+       * Index of the next result tuple to consume in resultTuples
+       */
+      unsigned int nextResultTuple;
+
+      /**
+       * Keys of the selected tuples of the batch being probed, back to back
+       */
+      string batchKeyData;
+
+      /**
+       * Offset of each key in batchKeyData, followed by the size of batchKeyData
+       */
+      vector<uint32_t> batchKeyOffsets;
+
+      /**
+       * Get the key of the i-th selected tuple of the batch being probed
+       */
+      KeyView getBatchKey(int i) const {
+        return KeyView(batchKeyData.data() + batchKeyOffsets[i],
+            batchKeyOffsets[i + 1] - batchKeyOffsets[i]);
+      }
+
+      /**
+       * Matching build tuples of each selected tuple of the batch being probed
+       */
+      vector<JoinHashTable::MatchIterator> batchMatches;
+
+      /**
+       * Hash of the key of each selected tuple of the batch being probed
+       */
+      vector<std::size_t> batchHashes;
+
+      /**
+       * Is the executor completed
+       */
+      bool isComplete;
+
+      /**
+       * Number of result tuples
+       */
+      int numResultTuples;
+
+      /**
+       * Number of buffer pages actually used by the executor
+       */
+      int numUsedBufPages;
+
+      /**
+       * Number of I/Os carried out by the executor
+       */
+      int numIOs;
+
+      /**
+       * Get the ids of the attributes shared by both tables, i.e. the attributes
+       * the natural join is computed on
+       */
+      void getJoinAttrsID(vector<int> &joinAttrsIDLeft,
+          vector<int> &joinAttrsIDRight) const;
+
+      /**
+       * Join a tuple of the left table with a tuple of the right table. The join
+       * attributes of the right tuple are left out as the left tuple has them.
+       */
+      string joinTuples(const RecordView &leftRecord, const RecordView &rightRecord) const;
+
+      /**
+       * Probe a hash table built on one input with a tuple of the other input,
+       * adding the joined tuples to the result tuples
+       */
+      void probe(const JoinHashTable &hashTable, const RecordView &record,
+          const vector<int> &probeAttrsID, bool isBuildLeft);
+
+      /**
+       * Probe a hash table built on one input with the selected tuples of a
+       * batch of the other input, adding the joined tuples to the result
+       * tuples. All the keys are looked up before any tuple is joined, and
+       * the selection of the batch is narrowed to the tuples with a match.
+       */
+      void probe(const JoinHashTable &hashTable, TupleBatch &batch,
+          const vector<int> &probeAttrsID, bool isBuildLeft);
+
+      /**
+       * Produce the next result tuples into resultTuples. A call may produce
+       * no tuple, e.g. when a probe tuple has no match.
+       * @return If the join is done, return false
+       */
+      virtual bool fill() = 0;
+
+    public:
+      /**
+       * Default number of buffer pages a join may use
+       */
+      static const int DEFAULT_NUM_AVAILABLE_BUF_PAGES = 10;
+
+      /**
+       * Constructor of a join of two tables
+       * @param isRightRescanned Is the right table scanned many times? Its
+       *        pages are then kept in the buffer pool instead of a ring.
+       */
+      JoinOperator(File &leftTableFile, File &rightTableFile,
+          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
+          const Catalog *catalog, BufMgr *bufMgr, bool isRightRescanned = false);
+
+      /**
+       * Constructor of a join of the tuples produced by two operators
+       */
+      JoinOperator(Operator &leftInput, Operator &rightInput, const Catalog *catalog,
+          BufMgr *bufMgr);
+
+      /**
+       * Destructor
+       */
+      virtual ~JoinOperator();
+
+      /**
+       * Is the algorithm complete?
+       */
+      bool isCompleted() const {
+        return isComplete;
+      }
+
+      /**
+       * Get the operator's name
+       */
+      virtual string getOperatorName() const {
+        return "JOIN";
+      }
+
+      /**
+       * Print the running statistics of the executor
+       */
+      virtual void printRunningStats() const;
+
+      /**
+       * Set the number of buffer pages the join may use, taking effect when
+       * it is opened
+       */
+      void setNumAvailableBufPages(int numAvailableBufPages) {
+        this->numAvailableBufPages = numAvailableBufPages;
+      }
+
+      const TableSchema& getSchema() const {
+        return resultTableSchema;
+      }
+
+      /**
+       * Estimate the number of pages of the result as the pages of both inputs
+       */
+      int estimateNumPages() const;
+
+      /**
+       * Reset the running statistics and open the inputs the join reads first
+       * (overrided by the algorithms, which call it first)
+       */
+      void open();
+
+      bool next(RecordView &tuple);
+
+      bool nextBatch(TupleBatch &batch);
+
+      /**
+       * Close the inputs (overrided by the algorithms, which call it last)
+       */
+      void close();
+
+      /**
+       * Execute the join algorithm, writing the result into a file. The
+       * temporary files are named after the result file.
+       * @return If succeeded, return true
+       */
+      virtual bool execute(int numAvailableBufPages, File &resultFile);
+
+      /**
+       * Get the schema of the result table
+       */
+      const TableSchema& getResultTableSchema() const {
+        return resultTableSchema;
+      }
+
+      /**
+       * Get number of result tuples
+       */
+      int getNumResultTuples() const {
+        return numResultTuples;
+      }
+
+      /**
+       * Get number of buffer pages used by the executor
+       */
+      int getNumUsedBufPages() const {
+        return numUsedBufPages;
+      }
+
+      /**
+       * Get number of I/Os carried out by the executor
+       */
+      int getNumIOs() const {
+        return numIOs;
+      }
+
+      /**
+       * Create the result schema using the input schemas
+       */
+      static TableSchema createResultTableSchema(const TableSchema &leftTableSchema,
+          const TableSchema &rightTableSchema);
+  };
+
+  class OnePassJoinOperator: public JoinOperator {
+    private:
+      /**
+       * Hash table on the left input
+       */
+      JoinHashTable hashTable;
+
+      /**
+       * Batch of right tuples being probed
+       */
+      TupleBatch probeBatch;
+
+      /**
+       * Is the hash table on the left input radix-partitioned?
+       */
+      bool isRadixPartitioned;
+
+      /**
+       * Radix-partitioned hash table on the left input
+       */
+      RadixHashTable radixHashTable;
+
+      /**
+       * Number of partitions of the radix-partitioned hash table
+       */
+      int numRadixPartitions;
+
+      /**
+       * Number of partitioning passes of the radix-partitioned hash table
+       */
+      int numRadixPasses;
+
+      /**
+       * Selected tuples of the batch being probed, as their partition in the
+       * upper 16 bits and their index in the selection in the lower ones
+       */
+      vector<uint32_t> probeOrder;
+
+      /**
+       * Left tuples matching the tuple being probed
+       */
+      vector<RecordView> probeMatches;
+
+      /**
+       * Probe the radix-partitioned hash table with the selected tuples of a
+       * batch, visiting them partition by partition
+       */
+      void probeRadix(TupleBatch &batch);
+
+    protected:
+      bool fill();
+
+    public:
+      /**
+       * Constructor
+       */
+      OnePassJoinOperator(File &leftTableFile, File &rightTableFile,
+          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          JoinOperator(leftTableFile, rightTableFile, leftTableSchema, rightTableSchema,
+              catalog, bufMgr), probeBatch(rightTupleLayout), isRadixPartitioned(false),
+              numRadixPartitions(0), numRadixPasses(0) {
+        // nothing
+      }
+
+      /**
+       * Constructor
+       */
+      OnePassJoinOperator(Operator &leftInput, Operator &rightInput, const Catalog *catalog,
+          BufMgr *bufMgr) :
+          JoinOperator(leftInput, rightInput, catalog, bufMgr), probeBatch(rightTupleLayout),
+              isRadixPartitioned(false), numRadixPartitions(0), numRadixPasses(0) {
+        // nothing
+      }
+
+      /**
+       * Destructor
+       */
+      ~OnePassJoinOperator() {
+        // nothing
+      }
+
+      /**
+       * Get oprator's name (overrided)
+       */
+      string getOperatorName() const {
+        return "ONE_PASS_JOIN";
+      }
+
+      /**
+       * Build a radix-partitioned hash table instead of a map, for a left
+       * input larger than the cache
+       */
+      void setRadixPartitioned(bool isRadixPartitioned) {
+        this->isRadixPartitioned = isRadixPartitioned;
+      }
+
+      /**
+       * Set the target number of bytes of a partition of the radix-partitioned
+       * hash table, RadixHashTable::CACHE_SIZE by default
+       */
+      void setRadixPartitionSize(std::size_t partitionSize) {
+        this->radixHashTable.setPartitionSize(partitionSize);
+      }
+
+      /**
+       * Print running statistics (overrided)
+       */
+      void printRunningStats() const;
+
+      void open();
+
+      void close();
+  };
+
+  class NestedLoopJoinOperator: public JoinOperator {
+    private:
+      /**
+       * Hash table on the block of left tuples being joined
+       */
+      JoinHashTable blockHashTable;
+
+      /**
+       * Have all the left tuples been read?
+       */
+      bool isLeftExhausted;
+
+      /**
+       * Is the right input being scanned for the current block?
+       */
+      bool isRightOpen;
+
+      /**
+       * Batch of right tuples being probed
+       */
+      TupleBatch probeBatch;
+
+    protected:
+      bool fill();
+
+    public:
+      /**
+       * Constructor
+       */
+      NestedLoopJoinOperator(File &leftTableFile, File &rightTableFile,
+          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          JoinOperator(leftTableFile, rightTableFile, leftTableSchema, rightTableSchema,
+              catalog, bufMgr, true /* isRightRescanned */), isLeftExhausted(false),
+              isRightOpen(false), probeBatch(rightTupleLayout) {
+        // nothing
+      }
+
+      /**
+       * Constructor
+       */
+      NestedLoopJoinOperator(Operator &leftInput, Operator &rightInput,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          JoinOperator(leftInput, rightInput, catalog, bufMgr), isLeftExhausted(false),
+              isRightOpen(false), probeBatch(rightTupleLayout) {
+        // nothing
+      }
+
+      /**
+       * Destructor
+       */
+      ~NestedLoopJoinOperator() {
+        // nothing
+      }
+
+      /**
+       * Get oprator's name (overrided)
+       */
+      string getOperatorName() const {
+        return "NESTED_LOOP_JOIN";
+      }
+
+      void open();
+
+      void close();
+  };
+
+  class SortMergeJoinOperator: public JoinOperator {
+    private:
+      /**
+       * Number of sorted runs of the left table
+       */
+      int numLeftRuns;
+
+      /**
+       * Number of sorted runs of the right table
+       */
+      int numRightRuns;
+
+      /**
+       * Number of passes to sort the left table
+       */
+      int numLeftPasses;
+
+      /**
+       * Number of passes to sort the right table
+       */
+      int numRightPasses;
+
+      /**
+       * Sorted left input
+       */
+      File *leftSortedFile;
+
+      /**
+       * Sorted right input
+       */
+      File *rightSortedFile;
+
+      /**
+       * Reader of the sorted left input
+       */
+      RunReader *leftReader;
+
+      /**
+       * Reader of the sorted right input
+       */
+      RunReader *rightReader;
+
+      /**
+       * Current left tuple, if hasLeft
+       */
+      RecordView leftRecord;
+
+      /**
+       * Current right tuple, if hasRight
+       */
+      RecordView rightRecord;
+
+      /**
+       * Sort key of the current left tuple
+       */
+      string leftKey;
+
+      /**
+       * Sort key of the current right tuple
+       */
+      string rightKey;
+
+      /**
+       * Is there a current left tuple?
+       */
+      bool hasLeft;
+
+      /**
+       * Is there a current right tuple?
+       */
+      bool hasRight;
+
+      /**
+       * Left tuples with the key being joined
+       */
+      vector<string> leftGroup;
+
+      /**
+       * Key of the left tuples in leftGroup
+       */
+      string groupKey;
+
+      /**
+       * Read the next tuple of the sorted left input and its join key
+       */
+      void nextLeft();
+
+      /**
+       * Read the next tuple of the sorted right input and its join key
+       */
+      void nextRight();
+
+    protected:
+      bool fill();
+
+    public:
+      /**
+       * Constructor
+       */
+      SortMergeJoinOperator(File &leftTableFile, File &rightTableFile,
+          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          JoinOperator(leftTableFile, rightTableFile, leftTableSchema, rightTableSchema,
+              catalog, bufMgr), numLeftRuns(0), numRightRuns(0), numLeftPasses(0),
+              numRightPasses(0), leftSortedFile(NULL), rightSortedFile(NULL),
+              leftReader(NULL), rightReader(NULL), hasLeft(false), hasRight(false) {
+        // nothing
+      }
+
+      /**
+       * Constructor
+       */
+      SortMergeJoinOperator(Operator &leftInput, Operator &rightInput,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          JoinOperator(leftInput, rightInput, catalog, bufMgr), numLeftRuns(0),
+              numRightRuns(0), numLeftPasses(0), numRightPasses(0), leftSortedFile(NULL),
+              rightSortedFile(NULL), leftReader(NULL), rightReader(NULL), hasLeft(false),
+              hasRight(false) {
+        // nothing
+      }
+
+      /**
+       * Destructor
+       */
+      ~SortMergeJoinOperator() {
+        this->close();
+      }
+
+      /**
+       * Get oprator's name (overrided)
+       */
+      string getOperatorName() const {
+        return "SORT_MERGE_JOIN";
+      }
+
+      /**
+       * Print running statistics (overrided)
+       */
+      void printRunningStats() const;
+
+      void open();
+
+      void close();
+  };
+
+  /**
+   * Bucket Id type
+   */
+  typedef std::uint32_t BucketId;
+
+  /**
+   * Hash join partitioning its inputs into buckets on disk and joining the
+   * pairs of buckets one at a time
+   */
+  class BucketJoinOperator: public JoinOperator {
+    protected:
+      /**
+       * Number of times a bucket is split further before it is joined a block
+       * of build tuples at a time
+       */
+      static const int MAX_PARTITION_LEVELS = 3;
+
+      /**
+       * Number of buckets, including the ones split from a bucket too large to
+       * be joined in memory
+       */
+      int numBuckets;
+
+      /**
+       * Bucket files of the left table, NULL for a bucket kept in memory
+       */
+      vector<File*> leftBucketFiles;
+
+      /**
+       * Bucket files of the right table, NULL for a bucket kept in memory
+       */
+      vector<File*> rightBucketFiles;
+
+      /**
+       * Pages of the left table in each bucket
+       */
+      vector<vector<PageId>> leftBucketPages;
+
+      /**
+       * Pages of the right table in each bucket
+       */
+      vector<vector<PageId>> rightBucketPages;
+
+      /**
+       * Number of tuples of the left table in each bucket
+       */
+      vector<int> numLeftBucketTuples;
+
+      /**
+       * Number of tuples of the right table in each bucket
+       */
+      vector<int> numRightBucketTuples;
+
+      /**
+       * Number of pages of the left table in each bucket
+       */
+      vector<int> numLeftBucketPages;
+
+      /**
+       * Number of pages of the right table in each bucket
+       */
+      vector<int> numRightBucketPages;
+
+      /**
+       * Number of times the tuples of each bucket were partitioned, 0 for the
+       * buckets of the partition stage
+       */
+      vector<int> bucketLevels;
+
+      /**
+       * First bucket split from each bucket, or -1 if it is not split
+       */
+      vector<int> firstSubBuckets;
+
+      /**
+       * Number of blocks of build tuples each bucket is joined in
+       */
+      vector<int> numBucketBlocks;
+
+      /**
+       * Hash table on the build side of the bucket being joined
+       */
+      JoinHashTable hashTable;
+
+      /**
+       * Next pair of buckets to join
+       */
+      int nextBucket;
+
+      /**
+       * Bucket being joined
+       */
+      int joinedBucket;
+
+      /**
+       * Reader of the build side of the bucket being joined, or NULL
+       */
+      RunReader *buildReader;
+
+      /**
+       * Build tuple read but left out of the hash table for lack of space
+       */
+      RecordView pendingBuildRecord;
+
+      /**
+       * Is there a build tuple left out of the hash table?
+       */
+      bool isBuildRecordPending;
+
+      /**
+       * Reader of the probe side of the bucket being joined, or NULL
+       */
+      RunReader *probeReader;
+
+      /**
+       * Is the hash table of the bucket being joined built on the left side?
+       */
+      bool isBucketBuildLeft;
+
+      /**
+       * Create the bucket files from the given bucket on, the buckets before
+       * it are kept in memory
+       */
+      void createBucketFiles(int firstBucket);
+
+      /**
+       * Append empty buckets, with their files, to the others
+       * @return Id of the first new bucket
+       */
+      int addBuckets(int numNewBuckets, int level);
+
+      /**
+       * Count the pages of each bucket
+       */
+      void countBucketPages();
+
+      /**
+       * Hash function from key to one of the buckets split from a bucket of
+       * the given level; every level hashes the key differently
+       */
+      BucketId subHash(const string &key, int level, int numSubBuckets) const;
+
+      /**
+       * Partition the tuples of one side of a bucket into the buckets split
+       * from it
+       */
+      void splitBucket(File *file, const vector<PageId> &pages, const TupleLayout &tupleLayout,
+          const vector<int> &joinAttrsID, int level, int firstSubBucket,
+          vector<File*> &bucketFiles, vector<vector<PageId>> &bucketPages,
+          vector<int> &bucketTuples);
+
+      /**
+       * Split a bucket too large to be joined in memory into max(B-1, 2)
+       * buckets appended to the others, and remove its files
+       */
+      void repartitionBucket(int bucket);
+
+      /**
+       * Fill the hash table with the build tuples of the bucket being joined
+       * until they are all read or the next one does not fit in the budget of
+       * the hash table
+       * @return If a build tuple is left, return true
+       */
+      bool buildBlock();
+
+      /**
+       * Close the reader of the build side of the bucket being joined
+       */
+      void closeBuildReader();
+
+      /**
+       * Join the next pair of buckets read back through the buffer pool. The
+       * hash table is built on the smaller bucket and probed with the other one.
+       * A bucket whose build side does not fit in the budget of the hash table
+       * is split with another hash function, and one that is still too large
+       * after MAX_PARTITION_LEVELS splits, because most of its tuples share a
+       * key, is joined a block of build tuples at a time, rereading the probe
+       * side for each block.
+       * @return If all pairs of buckets are joined, return false
+       */
+      bool fillFromBuckets();
+
+      /**
+       * Print the sizes of a bucket
+       */
+      void printBucketStats(int bucket) const;
+
+    public:
+      /**
+       * Constructor
+       */
+      BucketJoinOperator(File &leftTableFile, File &rightTableFile,
+          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          JoinOperator(leftTableFile, rightTableFile, leftTableSchema, rightTableSchema,
+              catalog, bufMgr), numBuckets(0), nextBucket(0), joinedBucket(-1),
+              buildReader(NULL), isBuildRecordPending(false), probeReader(NULL),
+              isBucketBuildLeft(true) {
+        // nothing
+      }
+
+      /**
+       * Constructor
+       */
+      BucketJoinOperator(Operator &leftInput, Operator &rightInput, const Catalog *catalog,
+          BufMgr *bufMgr) :
+          JoinOperator(leftInput, rightInput, catalog, bufMgr), numBuckets(0),
+              nextBucket(0), joinedBucket(-1), buildReader(NULL), isBuildRecordPending(false),
+              probeReader(NULL), isBucketBuildLeft(true) {
+        // nothing
+      }
+
+      /**
+       * Destructor
+       */
+      ~BucketJoinOperator() {
+        this->close();
+      }
+
+      /**
+       * Get number of buckets
+       */
+      int getNumBuckets() const {
+        return numBuckets;
+      }
+
+      /**
+       * Remove the bucket files (overrided by the algorithms, which call it
+       * last)
+       */
+      void close();
+  };
+
+  class GraceHashJoinOperator: public BucketJoinOperator {
+    private:
+      /**
+       * Hash function from key to bucket Id
+       */
+      BucketId hash(const string &key) const;
+
+      /**
+       * Partition the tuples of an input into the bucket files by hashing the
+       * join key of every tuple. The pages written to each bucket are recorded
+       * in bucketPages so that they can be read back through the buffer pool.
+       */
+      void partition(Operator &input, const TupleLayout &tupleLayout,
+          const vector<int> &joinAttrsID, vector<File*> &bucketFiles,
+          vector<vector<PageId>> &bucketPages, vector<int> &bucketTuples);
+
+    protected:
+      bool fill();
+
+    public:
+      /**
+       * Constructor
+       */
+      GraceHashJoinOperator(File &leftTableFile, File &rightTableFile,
+          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          BucketJoinOperator(leftTableFile, rightTableFile, leftTableSchema,
+              rightTableSchema, catalog, bufMgr) {
+        // nothing
+      }
+
+      /**
+       * Constructor
+       */
+      GraceHashJoinOperator(Operator &leftInput, Operator &rightInput,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          BucketJoinOperator(leftInput, rightInput, catalog, bufMgr) {
+        // nothing
+      }
+
+      /**
+       * Destructor
+       */
+      ~GraceHashJoinOperator() {
+        // nothing
+      }
+
+      /**
+       * Get oprator's name (overrided)
+       */
+      string getOperatorName() const {
+        return "GRACE_HASH_JOIN";
+      }
+
+      /**
+       * Print running statistics (overrided)
+       */
+      void printRunningStats() const;
+
+      void open();
+  };
+
+  class HybridHashJoinOperator: public BucketJoinOperator {
+    private:
+      /**
+       * Share (in 1/1000) of the hash values that fall into bucket 0
+       */
+      int memoryShare;
+
+      /**
+       * Number of buffer pages reserved for the hash table of bucket 0
+       */
+      int numMemPages;
+
+      /**
+       * Is the hash table of bucket 0 built on the left input?
+       */
+      bool isBuildLeft;
+
+      /**
+       * Is the probe input being read, joining bucket 0 at once?
+       */
+      bool isProbeOpen;
+
+      /**
+       * Page of each spilled bucket of the probe input currently pinned as
+       * its output buffer
+       */
+      vector<PageId> bucketPageNos;
+
+      /**
+       * The pinned output pages of the spilled buckets
+       */
+      vector<Page*> bucketPagePointers;
+
+      /**
+       * Has each spilled bucket taken tuples of bucket 0 that did not fit in
+       * the hash table?
+       */
+      vector<bool> overflowBuckets;
+
+      /**
+       * Number of build tuples of bucket 0 that did not fit in the hash table
+       */
+      int numOverflowTuples;
+
+      /**
+       * Hash function from key to bucket Id
+       */
+      BucketId hash(const string &key) const;
+
+      /**
+       * Hash function from key to the spilled bucket taking the tuples of
+       * bucket 0 that do not fit in the hash table
+       */
+      BucketId overflowHash(const string &key) const;
+
+      /**
+       * Unpin the output pages of the spilled buckets and flush them
+       */
+      void flushBuckets(const vector<File*> &bucketFiles,
+          const vector<vector<PageId>> &bucketPages);
+
+    protected:
+      bool fill();
+
+    public:
+      /**
+       * Constructor
+       */
+      HybridHashJoinOperator(File &leftTableFile, File &rightTableFile,
+          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          BucketJoinOperator(leftTableFile, rightTableFile, leftTableSchema,
+              rightTableSchema, catalog, bufMgr), memoryShare(0), numMemPages(0),
+              isBuildLeft(true), isProbeOpen(false), numOverflowTuples(0) {
+        // nothing
+      }
+
+      /**
+       * Constructor
+       */
+      HybridHashJoinOperator(Operator &leftInput, Operator &rightInput,
+          const Catalog *catalog, BufMgr *bufMgr) :
+          BucketJoinOperator(leftInput, rightInput, catalog, bufMgr), memoryShare(0),
+              numMemPages(0), isBuildLeft(true), isProbeOpen(false), numOverflowTuples(0) {
+        // nothing
+      }
+
+      /**
+       * Destructor
+       */
+      ~HybridHashJoinOperator() {
+        this->close();
+      }
+
+      /**
+       * Get oprator's name (overrided)
+       */
+      string getOperatorName() const {
+        return "HYBRID_HASH_JOIN";
+      }
+
+      /**
+       * Print running statistics (overrided)
+       */
+      void printRunningStats() const;
+
+      void open();
+
+      void close();
+  };
+
+  /**
+   * Hash join run by several worker threads. Both tables are split into
+   * morsels of MORSEL_PAGES consecutive pages, which the workers take one at
+   * a time from a shared counter, so a worker done early keeps taking the
+   * morsels left instead of waiting for the others. The build stage hashes
+   * the left table into one partition per worker, then each worker builds
+   * the hash table of its partition, so no hash table is shared while it is
+   * built. The probe stage reads the pages of a right morsel at the same
+   * time, looks the right tuples up in the hash table of their partition,
+   * and each worker writes the joined tuples to its own
+   * result pages. Read through next(), the join probes a morsel per worker
+   * at a time and keeps their joined tuples in memory until they are read.
+   * The worker threads are started by open() and joined by close(); in
+   * between, each stage is handed to them through a condition variable.
+   */
+  class ParallelHashJoinOperator: public JoinOperator {
+    public:
+      /**
+       * Number of pages of a morsel
+       */
+      static const unsigned int MORSEL_PAGES = 4;
+
+    private:
+      /**
+       * Number of worker threads asked for
+       */
+      int numWorkers;
+
+      /**
+       * Number of worker threads of the current run, each pinning a morsel of
+       * its input and a result page
+       */
+      int numActiveWorkers;
+
+      /**
+       * Pages of the left table
+       */
+      vector<PageId> buildPageNos;
+
+      /**
+       * Pages of the right table
+       */
+      vector<PageId> probePageNos;
+
+      /**
+       * First page of the next morsel to take
+       */
+      std::atomic<unsigned int> nextMorsel;
+
+      /**
+       * Number of morsels of both tables
+       */
+      int numMorsels;
+
+      /**
+       * Number of morsels a probe worker takes before it returns, or 0 for
+       * no limit
+       */
+      unsigned int maxWorkerMorsels;
+
+      /**
+       * Left tuples read by each worker, as (join key, tuple) pairs, by partition
+       */
+      vector<vector<vector<pair<string, string>>>> workerPartitions;
+
+      /**
+       * Hash table of each partition
+       */
+      vector<JoinHashTable> hashTables;
+
+      /**
+       * Bytes the hash tables may use together
+       */
+      std::size_t hashTablesBudget;
+
+      /**
+       * Bytes used by the hash tables together, as counted by getSize()
+       */
+      std::atomic<std::size_t> hashTablesSize;
+
+      /**
+       * Have the hash tables gone over hashTablesBudget?
+       */
+      std::atomic<bool> isBuildOverBudget;
+
+      /**
+       * File the workers write the joined tuples to, or NULL to keep them in
+       * workerResultTuples
+       */
+      File *probeResultFile;
+
+      /**
+       * Joined tuples of each worker when there is no result file
+       */
+      vector<vector<string>> workerResultTuples;
+
+      /**
+       * Number of joined tuples of each worker
+       */
+      vector<int> workerNumResultTuples;
+
+      /**
+       * Number of I/Os of each worker
+       */
+      vector<int> workerNumIOs;
+
+      /**
+       * Has the right table been probed?
+       */
+      bool isProbed;
+
+      /**
+       * Worker threads, running between open() and close()
+       */
+      vector<std::thread> workerThreads;
+
+      /**
+       * Latch protecting the task handed to the workers
+       */
+      std::mutex workerLatch;
+
+      /**
+       * Signalled when a task is handed to the workers or they are stopped
+       */
+      std::condition_variable workerCondition;
+
+      /**
+       * Signalled when the last busy worker is done with its task
+       */
+      std::condition_variable workerDoneCondition;
+
+      /**
+       * Task the workers run next
+       */
+      void (ParallelHashJoinOperator::*workerTask)(int);
+
+      /**
+       * Number of tasks handed to the workers so far
+       */
+      unsigned int numWorkerTasks;
+
+      /**
+       * Number of workers still running the current task
+       */
+      int numBusyWorkers;
+
+      /**
+       * First exception thrown by a worker in the current task
+       */
+      std::exception_ptr workerError;
+
+      /**
+       * Are the workers asked to return?
+       */
+      bool isWorkerStopping;
+
+      /**
+       * Get the pages of a table, in the order of a scan
+       */
+      static vector<PageId> getPageNos(File &file);
+
+      /**
+       * Get the partition of a join key
+       */
+      int getPartition(const string &key) const;
+
+      /**
+       * Take the next morsel of a table
+       * @return If no morsel is left, return false
+       */
+      bool claimMorsel(const vector<PageId> &pageNos, unsigned int &first,
+          unsigned int &last);
+
+      /**
+       * Start a worker thread per active worker
+       */
+      void startWorkers();
+
+      /**
+       * Stop the worker threads and join them
+       */
+      void stopWorkers();
+
+      /**
+       * Loop of a worker thread, running each task handed to the workers
+       */
+      void runWorker(int worker);
+
+      /**
+       * Run a task on each worker thread and wait for all of them
+       * @throws The first exception thrown by a worker
+       */
+      void runWorkers(void (ParallelHashJoinOperator::*task)(int));
+
+      /**
+       * Read morsels of the left table into the partitions of a worker
+       */
+      void buildWorker(int worker);
+
+      /**
+       * Build the hash table of a partition from the tuples of all workers,
+       * stopping if the hash tables go over hashTablesBudget together
+       */
+      void mergeWorker(int partition);
+
+      /**
+       * Probe the hash tables with morsels of the right table
+       */
+      void probeWorker(int worker);
+
+      /**
+       * Add up the I/Os of the workers
+       */
+      void collectWorkerIOs();
+
+    protected:
+      bool fill();
+
+    public:
+      /**
+       * Constructor, with a worker per hardware thread
+       */
+      ParallelHashJoinOperator(File &leftTableFile, File &rightTableFile,
+          const TableSchema &leftTableSchema, const TableSchema &rightTableSchema,
+          const Catalog *catalog, BufMgr *bufMgr);
+
+      /**
+       * Destructor
+       */
+      ~ParallelHashJoinOperator() {
+        this->close();
+      }
+
+      /**
+       * Get oprator's name (overrided)
+       */
+      string getOperatorName() const {
+        return "PARALLEL_HASH_JOIN";
+      }
+
+      /**
+       * Set the number of worker threads. A run uses at most one worker per
+       * MORSEL_PAGES + 1 available buffer pages.
+       */
+      void setNumWorkers(int numWorkers) {
+        this->numWorkers = numWorkers;
+      }
+
+      /**
+       * Print running statistics (overrided)
+       */
+      void printRunningStats() const;
+
+      /**
+       * Build the hash tables in parallel
+       * @throws BufferExceededException If the hash tables do not fit in the
+       * buffer pages left by the probe workers
+       */
+      void open();
+
+      void close();
+
+      /**
+       * Execute the join algorithm, the workers writing the result into the
+       * file in parallel (overrided)
+       * @return If succeeded, return true
+       */
       bool execute(int numAvailableBufPages, File &resultFile);
   };
 
@@ -7,14 +7,22 @@
 
 #include "file.h"
 
-#include <fstream>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
@@ -23,18 +31,58 @@
 
 namespace badgerdb {
 
-  File::StreamMap File::open_streams_;
+  /**
+   * Throws a FileIOException unless a read or write on a file transferred all
+   * the bytes asked for.
+   */
+  static void checkTransfer(const ssize_t transferred, const std::size_t length,
+      const std::string &filename, const char *operation) {
+    if (transferred < 0 || (std::size_t) transferred != length) {
+      throw FileIOException(filename, operation);
+    }
+  }
+
+  FileHandle::~FileHandle() {
+    try {
+      flushHeader();
+    } catch (const FileIOException &e) {
+      // a destructor cannot report it; File::flush() does
+    }
+    if (attachment) {
+      try {
+        attachment->flush();
+      } catch (const FileIOException &e) {
+        // a destructor cannot report it; File::flush() does
+      }
+    }
+    if (map != NULL) {
+      munmap(const_cast<char*>(map.load()), map_size);
+    }
+    ::close(fd);
+  }
+
+  void FileHandle::flushHeader() {
+    if (header_dirty) {
+      checkTransfer(pwrite(fd, &header, sizeof(header), 0 /* pos */), sizeof(header),
+          filename, "pwrite");
+      header_dirty = false;
+    }
+  }
+
+  File::HandleMap File::open_handles_;
   File::CountMap File::open_counts_;
+  std::recursive_mutex File::latch_;
 
   File File::create(const std::string &filename) {
     return File(filename, true /* create_new */);
   }
 
-  File File::open(const std::string &filename) {
-    return File(filename, false /* create_new */);
+  File File::open(const std::string &filename, const bool map_pages) {
+    return File(filename, false /* create_new */, map_pages);
   }
 
   void File::remove(const std::string &filename) {
+    std::lock_guard<std::recursive_mutex> guard(latch_);
     if (!exists(filename)) {
       throw FileNotFoundException(filename);
     }
@@ -42,9 +90,11 @@ namespace badgerdb {
       throw FileOpenException(filename);
     }
     std::remove(filename.c_str());
+    std::remove(sidecarFilename(filename).c_str());
   }
 
   bool File::isOpen(const std::string &filename) {
+    std::lock_guard<std::recursive_mutex> guard(latch_);
     if (!exists(filename)) {
       return false;
     }
@@ -52,23 +102,20 @@ namespace badgerdb {
   }
 
   bool File::exists(const std::string &filename) {
-    std::fstream file(filename);
-    if (file) {
-      file.close();
-      return true;
-    }
-
-    return false;
+    return access(filename.c_str(), F_OK) == 0;
   }
 
   File::File(const File &other) :
-      filename_(other.filename_), stream_(open_streams_[filename_]) {
+      filename_(other.filename_) {
+    std::lock_guard<std::recursive_mutex> guard(latch_);
+    handle_ = open_handles_[filename_];
     ++open_counts_[filename_];
   }
 
   File& File::operator=(const File &rhs) {
     // This accounts for self-assignment and assignment of a File object for the
     // same file.
+    std::lock_guard<std::recursive_mutex> guard(latch_);
     close(); //close my file and associate me with the new one
     filename_ = rhs.filename_;
     openIfNeeded(false /* create_new */);
@@ -80,37 +127,34 @@ namespace badgerdb {
   }
 
   Page File::allocatePage() {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
     FileHeader header = readHeader();
     Page new_page;
-    Page existing_page;
     if (header.num_free_pages > 0) {
-      new_page = readPage(header.first_free_page, true /* allow_free */);
+      // Free pages hold no data, so only the free list link is needed.
       new_page.set_page_number(header.first_free_page);
-      header.first_free_page = new_page.next_page_number();
+      header.first_free_page = readPageHeader(header.first_free_page).next_page_number;
       --header.num_free_pages;
 
       if (header.first_used_page == Page::INVALID_NUMBER
           || header.first_used_page > new_page.page_number()) {
         // Either have no pages used or the head of the used list is a page later
         // than the one we just allocated, so add the new page to the head.
-        if (header.first_used_page > new_page.page_number()) {
-          new_page.set_next_page_number(header.first_used_page);
-        }
+        new_page.set_next_page_number(header.first_used_page);
         header.first_used_page = new_page.page_number();
       } else {
         // New page is reused from somewhere after the beginning, so we need to
         // find where in the used list to insert it.
-        PageId next_page_number = Page::INVALID_NUMBER;
-        for (FileIterator iter = begin(); iter != end(); ++iter) {
-          next_page_number = (*iter).next_page_number();
-          if (next_page_number > new_page.page_number()
-              || next_page_number == Page::INVALID_NUMBER) {
-            existing_page = *iter;
-            break;
-          }
+        PageId existing_page_number = header.first_used_page;
+        PageHeader existing_header = readPageHeader(existing_page_number);
+        while (existing_header.next_page_number != Page::INVALID_NUMBER
+            && existing_header.next_page_number < new_page.page_number()) {
+          existing_page_number = existing_header.next_page_number;
+          existing_header = readPageHeader(existing_page_number);
         }
-        existing_page.set_next_page_number(new_page.page_number());
-        new_page.set_next_page_number(next_page_number);
+        new_page.set_next_page_number(existing_header.next_page_number);
+        existing_header.next_page_number = new_page.page_number();
+        writePageHeader(existing_page_number, existing_header);
       }
 
       assert(
@@ -123,49 +167,110 @@ namespace badgerdb {
       } else {
         // If we have pages allocated, we need to add the new page to the tail
         // of the linked list.
-        for (FileIterator iter = begin(); iter != end(); ++iter) {
-          if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-            existing_page = *iter;
-            break;
-          }
+        PageId existing_page_number = header.first_used_page;
+        PageHeader existing_header = readPageHeader(existing_page_number);
+        while (existing_header.next_page_number != Page::INVALID_NUMBER) {
+          existing_page_number = existing_header.next_page_number;
+          existing_header = readPageHeader(existing_page_number);
         }
-        assert(existing_page.isUsed());
-        existing_page.set_next_page_number(new_page.page_number());
+        existing_header.next_page_number = new_page.page_number();
+        writePageHeader(existing_page_number, existing_header);
       }
       ++header.num_pages;
     }
     writePage(new_page.page_number(), new_page);
-    if (existing_page.page_number() != Page::INVALID_NUMBER) {
-      // If we updated an existing page by inserting the new page into the
-      // used list, we need to write it out.
-      writePage(existing_page.page_number(), existing_page);
-    }
     writeHeader(header);
 
     return new_page;
   }
 
   Page File::readPage(const PageId page_number) const {
-    FileHeader header = readHeader();
-    if (page_number >= header.num_pages) {
+    if (page_number >= handle_->num_pages.load(std::memory_order_acquire)) {
       throw InvalidPageException(page_number, filename_);
     }
-    return readPage(page_number, false /* allow_free */);
+    Page page;
+    readPage(page_number, false /* allow_free */, page);
+    return page;
   }
 
-  Page File::readPage(const PageId page_number, const bool allow_free) const {
-    Page page;
-    stream_->seekg(pagePosition(page_number), std::ios::beg);
-    stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(page.header_));
-    stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  void File::readPage(const PageId page_number, Page &page) const {
+    if (page_number >= handle_->num_pages.load(std::memory_order_acquire)) {
+      throw InvalidPageException(page_number, filename_);
+    }
+    readPage(page_number, false /* allow_free */, page);
+  }
+
+  void File::readPage(const PageId page_number, const bool allow_free, Page &page) const {
+    const char *map = handle_->map.load(std::memory_order_acquire);
+    const off_t position = pagePosition(page_number);
+    if (map != NULL && position + Page::SIZE <= handle_->map_size) {
+      std::memcpy(&page.header_, map + position, sizeof(page.header_));
+      std::memcpy(page.data_, map + position + sizeof(page.header_), Page::DATA_SIZE);
+    } else {
+      struct iovec iov[2];
+      iov[0].iov_base = &page.header_;
+      iov[0].iov_len = sizeof(page.header_);
+      iov[1].iov_base = page.data_;
+      iov[1].iov_len = Page::DATA_SIZE;
+      checkTransfer(preadv(handle_->fd, iov, 2, position), Page::SIZE, filename_,
+          "preadv");
+    }
     if (!allow_free && !page.isUsed()) {
       throw InvalidPageException(page_number, filename_);
     }
+  }
 
+  const Page* File::viewPage(const PageId page_number) const {
+    if (page_number >= handle_->num_pages.load(std::memory_order_acquire)) {
+      throw InvalidPageException(page_number, filename_);
+    }
+    const char *map = handle_->map.load(std::memory_order_acquire);
+    const off_t position = pagePosition(page_number);
+    if (map == NULL || position + Page::SIZE > handle_->map_size) {
+      return NULL;
+    }
+    // a page on disk has the layout of a Page object
+    const Page *page = reinterpret_cast<const Page*>(map + position);
+    if (!page->isUsed()) {
+      throw InvalidPageException(page_number, filename_);
+    }
     return page;
   }
 
+  std::size_t File::readPages(const PageId first_page_number, Page *const *pages,
+      const std::size_t count) const {
+    const PageId file_num_pages = handle_->num_pages.load(std::memory_order_acquire);
+    if (first_page_number >= file_num_pages) {
+      return 0;
+    }
+    const std::size_t num_pages = std::min(count,
+        (std::size_t) (file_num_pages - first_page_number));
+    const char *map = handle_->map.load(std::memory_order_acquire);
+    const off_t position = pagePosition(first_page_number);
+    if (map != NULL && position + num_pages * Page::SIZE <= handle_->map_size) {
+      for (std::size_t i = 0; i < num_pages; i++) {
+        const char *page_start = map + position + i * Page::SIZE;
+        std::memcpy(&pages[i]->header_, page_start, sizeof(pages[i]->header_));
+        std::memcpy(pages[i]->data_, page_start + sizeof(pages[i]->header_),
+            Page::DATA_SIZE);
+      }
+    } else {
+      std::vector<struct iovec> iov(2 * num_pages);
+      for (std::size_t i = 0; i < num_pages; i++) {
+        iov[2 * i].iov_base = &pages[i]->header_;
+        iov[2 * i].iov_len = sizeof(pages[i]->header_);
+        iov[2 * i + 1].iov_base = pages[i]->data_;
+        iov[2 * i + 1].iov_len = Page::DATA_SIZE;
+      }
+      checkTransfer(preadv(handle_->fd, &iov[0], iov.size(), position),
+          num_pages * Page::SIZE, filename_, "preadv");
+    }
+
+    return num_pages;
+  }
+
   void File::writePage(const Page &new_page) {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
     PageHeader header = readPageHeader(new_page.page_number());
     if (header.current_page_number == Page::INVALID_NUMBER) {
       // Page has been deleted since it was read.
@@ -180,36 +285,95 @@ namespace badgerdb {
     writePage(new_page.page_number(), header, new_page);
   }
 
+  void File::writePages(const Page *pages, const std::size_t count) {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
+    const PageId first_page_number = pages[0].page_number();
+    std::vector<PageHeader> headers(count);
+    for (std::size_t i = 0; i < count; i++) {
+      assert(pages[i].page_number() == first_page_number + i);
+      const PageHeader header = readPageHeader(first_page_number + i);
+      if (header.current_page_number == Page::INVALID_NUMBER) {
+        throw InvalidPageException(first_page_number + i, filename_);
+      }
+      // keep the next page pointer on disk, as writePage() does
+      headers[i] = pages[i].header_;
+      headers[i].next_page_number = header.next_page_number;
+    }
+    // a vectored write takes at most IOV_MAX buffers, two per page
+    const std::size_t max_pages = IOV_MAX / 2;
+    std::vector<struct iovec> iov;
+    for (std::size_t begin = 0; begin < count; begin += max_pages) {
+      const std::size_t num_pages = std::min(count - begin, max_pages);
+      iov.resize(2 * num_pages);
+      for (std::size_t i = 0; i < num_pages; i++) {
+        iov[2 * i].iov_base = &headers[begin + i];
+        iov[2 * i].iov_len = sizeof(PageHeader);
+        iov[2 * i + 1].iov_base = const_cast<char*>(pages[begin + i].data_);
+        iov[2 * i + 1].iov_len = Page::DATA_SIZE;
+      }
+      checkTransfer(pwritev(handle_->fd, &iov[0], iov.size(),
+          pagePosition(first_page_number + begin)), num_pages * Page::SIZE, filename_,
+          "pwritev");
+    }
+    for (std::size_t i = 0; i < count; i++) {
+      cachePageHeader(first_page_number + i, headers[i]);
+    }
+  }
+
   void File::deletePage(const PageId page_number) {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
     FileHeader header = readHeader();
-    Page existing_page = readPage(page_number);
-    Page previous_page;
+    if (page_number >= header.num_pages) {
+      throw InvalidPageException(page_number, filename_);
+    }
+    const PageHeader existing_header = readPageHeader(page_number);
+    if (existing_header.current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(page_number, filename_);
+    }
     // If this page is the head of the used list, update the header to point to
     // the next page in line.
     if (page_number == header.first_used_page) {
-      header.first_used_page = existing_page.next_page_number();
+      header.first_used_page = existing_header.next_page_number;
     } else {
       // Walk the used list so we can update the page that points to this one.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        previous_page = *iter;
-        if (previous_page.next_page_number() == existing_page.page_number()) {
-          previous_page.set_next_page_number(existing_page.next_page_number());
+      PageId previous_page_number = header.first_used_page;
+      while (previous_page_number != Page::INVALID_NUMBER) {
+        PageHeader previous_header = readPageHeader(previous_page_number);
+        if (previous_header.next_page_number == page_number) {
+          previous_header.next_page_number = existing_header.next_page_number;
+          writePageHeader(previous_page_number, previous_header);
           break;
         }
+        previous_page_number = previous_header.next_page_number;
       }
     }
     // Clear the page and add it to the head of the free list.
-    existing_page.initialize();
-    existing_page.set_next_page_number(header.first_free_page);
+    Page free_page;
+    free_page.set_next_page_number(header.first_free_page);
     header.first_free_page = page_number;
     ++header.num_free_pages;
-    if (previous_page.isUsed()) {
-      writePage(previous_page.page_number(), previous_page);
-    }
-    writePage(page_number, existing_page);
+    writePage(page_number, free_page);
     writeHeader(header);
   }
 
+  void File::flush() {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
+    handle_->flushHeader();
+    if (handle_->attachment) {
+      handle_->attachment->flush();
+    }
+  }
+
+  FileAttachment* File::attachment() const {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
+    return handle_->attachment.get();
+  }
+
+  void File::attach(FileAttachment *attachment) {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
+    handle_->attachment.reset(attachment);
+  }
+
   FileIterator File::begin() {
     const FileHeader &header = readHeader();
     return FileIterator(this, header.first_used_page);
@@ -219,50 +383,94 @@ namespace badgerdb {
     return FileIterator(this, Page::INVALID_NUMBER);
   }
 
-  File::File(const std::string &name, const bool create_new) :
+  File::File(const std::string &name, const bool create_new, const bool map_pages) :
       filename_(name) {
+    std::lock_guard<std::recursive_mutex> guard(latch_);
     openIfNeeded(create_new);
+    if (map_pages) {
+      mapIfNeeded();
+    }
 
     if (create_new) {
       // File starts with 1 page (the header).
       FileHeader header = { 1 /* num_pages */, 0 /* first_used_page */,
           0 /* num_free_pages */, 0 /* first_free_page */};
       writeHeader(header);
+      flush();
     }
   }
 
   void File::openIfNeeded(const bool create_new) {
+    std::lock_guard<std::recursive_mutex> guard(latch_);
     if (open_counts_.find(filename_) != open_counts_.end()) { //exists an entry already
       ++open_counts_[filename_];
-      stream_ = open_streams_[filename_];
+      handle_ = open_handles_[filename_];
     } else {
-      std::ios_base::openmode mode = std::fstream::in | std::fstream::out
-          | std::fstream::binary;
+      int flags = O_RDWR;
       const bool already_exists = exists(filename_);
       if (create_new) {
         // Error if we try to overwrite an existing file.
         if (already_exists) {
           throw FileExistsException(filename_);
         }
-        // New files have to be truncated on open.
-        mode = mode | std::fstream::trunc;
+        // New files have to be truncated on open, and a sidecar left behind
+        // by an earlier file of the same name does not belong to them.
+        flags = flags | O_CREAT | O_TRUNC;
+        std::remove(sidecarFilename(filename_).c_str());
       } else {
         // Error if we try to open a file that doesn't exist.
         if (!already_exists) {
           throw FileNotFoundException(filename_);
         }
       }
-      stream_.reset(new std::fstream(filename_, mode));
-      open_streams_[filename_] = stream_;
+      const int fd = ::open(filename_.c_str(), flags, 0644);
+      if (fd < 0) {
+        throw FileIOException(filename_, "open");
+      }
+      handle_.reset(new FileHandle(filename_, fd));
+      if (!create_new) {
+        checkTransfer(pread(handle_->fd, &handle_->header, sizeof(handle_->header),
+            0 /* pos */), sizeof(handle_->header), filename_, "pread");
+        handle_->num_pages.store(handle_->header.num_pages, std::memory_order_release);
+      }
+      open_handles_[filename_] = handle_;
       open_counts_[filename_] = 1;
     }
   }
 
+  void File::mapIfNeeded() {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
+    if (handle_->map != NULL) {
+      return;
+    }
+    struct stat file_stat;
+    if (fstat(handle_->fd, &file_stat) != 0 || file_stat.st_size == 0) {
+      return;
+    }
+    void *map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, handle_->fd, 0);
+    if (map == MAP_FAILED) {
+      // reads just go to the descriptor
+      return;
+    }
+    handle_->map_size = file_stat.st_size;
+    handle_->map.store(static_cast<const char*>(map), std::memory_order_release);
+  }
+
+  void File::readAt(void *buf, const std::size_t length, const off_t pos) const {
+    const char *map = handle_->map.load(std::memory_order_acquire);
+    if (map != NULL && pos + length <= handle_->map_size) {
+      std::memcpy(buf, map + pos, length);
+    } else {
+      checkTransfer(pread(handle_->fd, buf, length, pos), length, filename_, "pread");
+    }
+  }
+
   void File::close() {
+    std::lock_guard<std::recursive_mutex> guard(latch_);
     --open_counts_[filename_];
-    stream_.reset();
+    handle_.reset();
     if (open_counts_[filename_] == 0) {
-      open_streams_.erase(filename_);
+      open_handles_.erase(filename_);
       open_counts_.erase(filename_);
     }
   }
@@ -273,32 +481,55 @@ namespace badgerdb {
 
   void File::writePage(const PageId page_number, const PageHeader &header,
       const Page &new_page) {
-    stream_->seekp(pagePosition(page_number), std::ios::beg);
-    stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-    stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]), Page::DATA_SIZE);
-    stream_->flush();
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<PageHeader*>(&header);
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(new_page.data_);
+    iov[1].iov_len = Page::DATA_SIZE;
+    checkTransfer(pwritev(handle_->fd, iov, 2, pagePosition(page_number)),
+        Page::SIZE, filename_, "pwritev");
+    cachePageHeader(page_number, header);
   }
 
   FileHeader File::readHeader() const {
-    FileHeader header;
-    stream_->seekg(0 /* pos */, std::ios::beg);
-    stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
-
-    return header;
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
+    return handle_->header;
   }
 
   void File::writeHeader(const FileHeader &header) {
-    stream_->seekp(0 /* pos */, std::ios::beg);
-    stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-    stream_->flush();
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
+    handle_->header = header;
+    handle_->header_dirty = true;
+    handle_->num_pages.store(header.num_pages, std::memory_order_release);
   }
 
   PageHeader File::readPageHeader(PageId page_number) const {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
+    if (page_number < handle_->page_header_cached.size()
+        && handle_->page_header_cached[page_number]) {
+      return handle_->page_headers[page_number];
+    }
     PageHeader header;
-    stream_->seekg(pagePosition(page_number), std::ios::beg);
-    stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+    readAt(&header, sizeof(header), pagePosition(page_number));
+    cachePageHeader(page_number, header);
 
     return header;
   }
 
+  void File::writePageHeader(const PageId page_number, const PageHeader &header) {
+    checkTransfer(pwrite(handle_->fd, &header, sizeof(header),
+        pagePosition(page_number)), sizeof(header), filename_, "pwrite");
+    cachePageHeader(page_number, header);
+  }
+
+  void File::cachePageHeader(const PageId page_number, const PageHeader &header) const {
+    std::lock_guard<std::recursive_mutex> guard(handle_->latch);
+    if (page_number >= handle_->page_header_cached.size()) {
+      handle_->page_headers.resize(page_number + 1);
+      handle_->page_header_cached.resize(page_number + 1, false);
+    }
+    handle_->page_headers[page_number] = header;
+    handle_->page_header_cached[page_number] = true;
+  }
+
 }
@@ -7,10 +7,13 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/types.h>
 
 #include "page.h"
 
@@ -56,19 +59,153 @@ namespace badgerdb {
       }
   };
 
+  /**
+   * @brief State that a higher layer keeps in memory for an open file, such as
+   *        the free-space map of a heap file.
+   *
+   * It lives as long as the handle of the file, so it is shared by all File
+   * objects for the file, and it is flushed by File::flush() and when the file
+   * is closed.
+   */
+  class FileAttachment {
+    public:
+      virtual ~FileAttachment() {
+      }
+
+      /**
+       * Writes the state to disk if it has changed.
+       *
+       * @throws  FileIOException   If the write fails.
+       */
+      virtual void flush() = 0;
+  };
+
+  /**
+   * @brief Descriptor of an open file on disk, closed when destroyed.
+   *
+   * The handle holds the file header and the headers of the pages read or
+   * written so far, which are authoritative: all I/O on the file goes through
+   * its handle. Page headers are written through; the file header is written
+   * back by File::flush() and when the handle is destroyed.
+   *
+   * The file may also be mapped into memory read-only. The mapping is made
+   * once and kept until the handle is destroyed; it covers the file as it was
+   * when mapped, and reads past its end go to the descriptor.
+   */
+  struct FileHandle {
+      /**
+       * Name of the file, for error reports.
+       */
+      const std::string filename;
+
+      /**
+       * POSIX file descriptor.
+       */
+      int fd;
+
+      /**
+       * Latch serializing the changes of the page lists and the access to the
+       * headers below. It is recursive since compound operations such as
+       * File::allocatePage() call the other operations.
+       */
+      std::recursive_mutex latch;
+
+      /**
+       * Start of the read-only mapping of the file, or NULL if it is not
+       * mapped. Set after map_size.
+       */
+      std::atomic<const char*> map;
+
+      /**
+       * Number of bytes mapped.
+       */
+      std::size_t map_size;
+
+      /**
+       * Header of the file.
+       */
+      FileHeader header;
+
+      /**
+       * Whether header has changed since it was written to disk.
+       */
+      bool header_dirty;
+
+      /**
+       * Number of pages in header, readable without the latch, for the
+       * bounds checks of page reads.
+       */
+      std::atomic<PageId> num_pages;
+
+      /**
+       * Headers of the pages, indexed by page number, for the pages whose
+       * page_header_cached entry is set. The headers of free pages link the
+       * free list.
+       */
+      std::vector<PageHeader> page_headers;
+
+      /**
+       * Whether the header of each page is in page_headers.
+       */
+      std::vector<bool> page_header_cached;
+
+      /**
+       * State kept for the file by a higher layer, or NULL.
+       */
+      std::unique_ptr<FileAttachment> attachment;
+
+      /**
+       * Constructs a handle owning the given descriptor.
+       *
+       * @param filename  Name of the file.
+       * @param fd        Open file descriptor.
+       */
+      FileHandle(const std::string &filename, int fd) :
+          filename(filename), fd(fd), map(NULL), map_size(0), header_dirty(false),
+          num_pages(0) {
+      }
+
+      /**
+       * Writes the file header and the attachment back if they have changed,
+       * unmaps and closes the descriptor.
+       */
+      ~FileHandle();
+
+      /**
+       * Writes the file header to disk if it has changed.
+       *
+       * @throws  FileIOException   If the write fails.
+       */
+      void flushHeader();
+
+    private:
+      FileHandle(const FileHandle &other);
+      FileHandle& operator=(const FileHandle &rhs);
+  };
+
   /**
    * @brief Class which represents a file in the filesystem containing database
    *        pages.
    *
-   * The File class wraps a stream to an underlying file on disk.  Files contain
-   * fixed-sized pages, and they never deallocate space (though they do reuse
-   * deleted pages if possible).  If multiple File objects refer to the same
-   * underlying file, they will share the stream in memory.
+   * The File class wraps a descriptor of an underlying file on disk.  Files
+   * contain fixed-sized pages, and they never deallocate space (though they do
+   * reuse deleted pages if possible).  If multiple File objects refer to the same
+   * underlying file, they will share the descriptor.
    * If a file that has already been opened (possibly by another query), then the File class
-   * detects this (by looking in the open_streams_ map) and just returns a file object with
-   * the already created stream for the file without actually opening the UNIX file again.
+   * detects this (by looking in the open_handles_ map) and just returns a file object with
+   * the already opened descriptor for the file without actually opening the UNIX file again.
+   *
+   * Pages and headers are read and written with positional I/O (pread/pwrite),
+   * one system call each and with no shared file position, so reads from
+   * several threads do not wait for each other. Operations that change the
+   * linked lists of pages hold the latch of the file's handle; only opening
+   * and closing files hold a latch shared by all files. A failed or short
+   * read or write throws FileIOException.
    *
-   * @warning This class is not threadsafe.
+   * A file opened with map_pages set is also mapped into memory, for tables
+   * that are scanned over and over: reads are then copied from the mapping
+   * without a system call. Writes still go to the descriptor, and the shared
+   * mapping sees them.
    */
   class File {
     public:
@@ -77,23 +214,26 @@ namespace badgerdb {
        *
        * @param filename  Name of the file.
        * @throws  FileExistsException     If the requested file already exists.
+       * @throws  FileIOException         If the file cannot be created.
        */
       static File create(const std::string &filename);
 
       /**
        * Opens the file named fileName and returns the corresponding File object.
-       * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+       * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
        * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-       * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-       * open_streams_ map.
+       * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+       * open_handles_ map.
        *
        * @param filename  Name of the file.
+       * @param map_pages Whether to map the file into memory for reading.
        * @throws  FileNotFoundException   If the requested file doesn't exist.
+       * @throws  FileIOException         If the file cannot be opened or read.
        */
-      static File open(const std::string &filename);
+      static File open(const std::string &filename, const bool map_pages = false);
 
       /**
-       * Deletes an existing file.
+       * Deletes an existing file, together with its sidecar file if it has one.
        *
        * @param filename  Name of the file.
        * @throws  FileNotFoundException   If the file doesn't exist.
@@ -115,6 +255,18 @@ namespace badgerdb {
        */
       static bool exists(const std::string &filename);
 
+      /**
+       * Returns the name of the sidecar file kept next to a file, where the
+       * free-space map of a heap file is persisted.  The sidecar belongs to the
+       * file: it is removed with it and when the file is created again.
+       *
+       * @param filename  Name of the file.
+       * @return  Name of the sidecar file.
+       */
+      static std::string sidecarFilename(const std::string &filename) {
+        return filename + ".fsm";
+      }
+
       /**
        * Copy constructor.
        *
@@ -154,6 +306,36 @@ namespace badgerdb {
        */
       Page readPage(const PageId page_number) const;
 
+      /**
+       * Reads an existing page from the file into a given page, such as a
+       * buffer pool frame, without copying it.
+       *
+       * A page of a mapped file is copied out of the mapping even so: a frame
+       * must own its bytes, since pages are changed in place in the buffer pool
+       * and written back later, while the mapping is read-only and goes away
+       * when the file is closed.  Readers that only look at a page use
+       * FileIterator::view() instead, which does not copy mapped pages.
+       *
+       * @param page_number   Number of page to read.
+       * @param page          Page to read into.
+       * @throws  InvalidPageException  If the page doesn't exist in the file or is
+       *                                not currently used.
+       */
+      void readPage(const PageId page_number, Page &page) const;
+
+      /**
+       * Reads consecutive pages from the file with a single vectored read, for
+       * read-ahead.  Reading stops at the end of the file.  Free pages are read
+       * as well; their page number is Page::INVALID_NUMBER.
+       *
+       * @param first_page_number   Number of first page to read.
+       * @param pages               Pages to read into, one for each page.
+       * @param count               Number of pages to read.
+       * @return  Number of pages read.
+       */
+      std::size_t readPages(const PageId first_page_number, Page *const *pages,
+          const std::size_t count) const;
+
       /**
        * Writes a page into the file, replacing any existing contents.  The page
        * must have been already allocated in this file by a call to allocatePage().
@@ -163,6 +345,17 @@ namespace badgerdb {
        */
       void writePage(const Page &new_page);
 
+      /**
+       * Writes consecutive pages into the file with vectored writes, as
+       * writePage() does for each of them.
+       *
+       * @param pages   Pages to write, whose page numbers follow each other.
+       * @param count   Number of pages.
+       * @throws  InvalidPageException  If one of the pages has been deleted;
+       *                                no page is written then.
+       */
+      void writePages(const Page *pages, const std::size_t count);
+
       /**
        * Deletes a page from the file.
        *
@@ -170,6 +363,28 @@ namespace badgerdb {
        */
       void deletePage(const PageId page_number);
 
+      /**
+       * Writes the file header, which is kept in memory while the file is
+       * open, and the attachment of the file to disk.
+       */
+      void flush();
+
+      /**
+       * Returns the state a higher layer attached to the file, or NULL if
+       * there is none.
+       *
+       * @return  Attachment of the file.
+       */
+      FileAttachment* attachment() const;
+
+      /**
+       * Attaches state to the file, replacing any attachment.  The file takes
+       * ownership of it.
+       *
+       * @param attachment  State to attach.
+       */
+      void attach(FileAttachment *attachment);
+
       /**
        * Returns the name of the file this object represents.
        *
@@ -202,8 +417,8 @@ namespace badgerdb {
        * @param page_number   Number of page.
        * @return  Position of page in file.
        */
-      static std::streampos pagePosition(const PageId page_number) {
-        return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+      static off_t pagePosition(const PageId page_number) {
+        return sizeof(FileHeader) + ((off_t) (page_number - 1) * Page::SIZE);
       }
 
       /**
@@ -215,17 +430,18 @@ namespace badgerdb {
        * @see File::open()
        * @param name        Name of file.
        * @param create_new  Whether to create a new file.
+       * @param map_pages   Whether to map the file into memory for reading.
        * @throws  FileExistsException     If the underlying file exists and
        *                                  create_new is true.
        * @throws  FileNotFoundException   If the underlying file doesn't exist and
        *                                  create_new is false.
        */
-      File(const std::string &name, const bool create_new);
+      File(const std::string &name, const bool create_new, const bool map_pages = false);
 
       /**
        * Opens the underlying file named in filename_.
        * This method only opens the file if no other File objects exist that access
-       * the same filesystem file; otherwise, it reuses the existing stream.
+       * the same filesystem file; otherwise, it reuses the existing descriptor.
        *
        * @param create_new  Whether to create a new file.
        * @throws  FileExistsException     If the underlying file exists and
@@ -236,7 +452,36 @@ namespace badgerdb {
       void openIfNeeded(const bool create_new);
 
       /**
-       * Closes the underlying file stream in <stream_>.
+       * Maps the underlying file into memory, unless it is already mapped or
+       * empty.
+       */
+      void mapIfNeeded();
+
+      /**
+       * Returns the page with the given number in place in the mapping of the
+       * file, or NULL if the file is not mapped or the mapping does not cover
+       * the page.  The page sees later writes to the file, and it is valid
+       * while the file is open.
+       *
+       * @param page_number   Number of page.
+       * @return  Page in the mapping, or NULL.
+       * @throws  InvalidPageException  If the page doesn't exist in the file or is
+       *                                not currently used.
+       */
+      const Page* viewPage(const PageId page_number) const;
+
+      /**
+       * Reads bytes of the file, from the mapping if it covers them and with
+       * pread otherwise.
+       *
+       * @param buf     Buffer to read into.
+       * @param length  Number of bytes to read.
+       * @param pos     Offset in the file to read from.
+       */
+      void readAt(void *buf, const std::size_t length, const off_t pos) const;
+
+      /**
+       * Closes the underlying file descriptor in <handle_>.
        * This method only closes the file if no other File objects exist that access
        * the same file.
        */
@@ -246,16 +491,16 @@ namespace badgerdb {
        * Reads a page from the file.  If <allow_free> is not set, an exception
        * will be thrown if the page read from disk is not currently in use.
        *
-       * No bounds checking is performed; the underlying file stream will throw
-       * an exception if the page is past the end of the file.
+       * No bounds checking is performed; a page past the end of the file is
+       * read up to the end of the file.
        *
        * @param page_number   Number of page to read.
        * @param allow_free    Whether to allow reading a free (unused) page.
-       * @return  The page.
+       * @param page          Page to read into.
        * @throws  InvalidPageException  If the page is free (unused) and
        *                                allow_free is false.
        */
-      Page readPage(const PageId page_number, const bool allow_free) const;
+      void readPage(const PageId page_number, const bool allow_free, Page &page) const;
 
       /**
        * Writes a page into the file at the given page number.  This does not
@@ -280,50 +525,75 @@ namespace badgerdb {
           const Page &new_page);
 
       /**
-       * Reads the header for this file from disk.
+       * Returns the header for this file, as kept in memory.
        *
        * @return  The file header.
        */
       FileHeader readHeader() const;
 
       /**
-       * Writes the given header to the disk as the header for this file.
+       * Sets the header for this file. It is written to disk by flush() or
+       * when the file is closed.
        *
        * @param header  File header to write.
        */
       void writeHeader(const FileHeader &header);
 
       /**
-       * Reads only the header of the given page from disk (not the record data
-       * or slot table).  No bounds checking is performed.
+       * Returns only the header of the given page (not the record data or slot
+       * table), reading it from disk the first time.  No bounds checking is
+       * performed.
        *
        * @param page_number   Number of page whose header is to be read.
        * @return  Header of page.
        */
       PageHeader readPageHeader(const PageId page_number) const;
 
-      typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+      /**
+       * Writes only the header of the given page to disk.  No bounds checking is
+       * performed.
+       *
+       * @param page_number   Number of page whose header is to be replaced.
+       * @param header        Header of page to write.
+       */
+      void writePageHeader(const PageId page_number, const PageHeader &header);
+
+      /**
+       * Records the header of the given page as it is on disk.
+       *
+       * @param page_number   Number of page.
+       * @param header        Header of page.
+       */
+      void cachePageHeader(const PageId page_number, const PageHeader &header) const;
+
+      typedef std::map<std::string, std::shared_ptr<FileHandle> > HandleMap;
       typedef std::map<std::string, int> CountMap;
 
       /**
-       * Streams for opened files.
+       * Descriptors for opened files.
        */
-      static StreamMap open_streams_;
+      static HandleMap open_handles_;
 
       /**
        * Counts for opened files.
        */
       static CountMap open_counts_;
 
+      /**
+       * Latch serializing the operations on open_handles_ and open_counts_. It
+       * is recursive since operator=() closes and opens files.
+       */
+      static std::recursive_mutex latch_;
+
       /**
        * Name of the file this object represents.
        */
       std::string filename_;
 
       /**
-       * Stream for underlying filesystem object.
+       * Descriptor for underlying filesystem object.
        */
-      std::shared_ptr<std::fstream> stream_;
+      std::shared_ptr<FileHandle> handle_;
 
       friend class FileIterator;
       friend class FileTest;
@@ -103,6 +103,32 @@ class FileIterator {
 	inline Page operator*() const
   { return file_->readPage(current_page_number_); }
 
+  /**
+   * Returns the current page in place if the file is mapped, and reads it
+   * into the given page otherwise.  Unlike operator*(), this does not copy
+   * a mapped page; the result is valid while the file is open and, if it is
+   * the given page, while that page lives.
+   *
+   * @param page  Page to read into if the file is not mapped.
+   * @return  Page in file.
+   */
+  inline const Page& view(Page &page) const {
+    const Page* mapped_page = file_->viewPage(current_page_number_);
+    if (mapped_page != NULL) {
+      return *mapped_page;
+    }
+    file_->readPage(current_page_number_, page);
+    return page;
+  }
+
+  /**
+   * Returns the number of the current page, without reading the page.
+   *
+   * @return  Number of page iterator is currently pointing to.
+   */
+  inline PageId page_number() const
+  { return current_page_number_; }
+
  private:
   /**
    * File we're iterating over.
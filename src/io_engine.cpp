@@ -0,0 +1,60 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io_engine.h"
+
+namespace badgerdb {
+
+  IoEngine::IoEngine(std::uint32_t numThreads) :
+      isStopping(false) {
+    for (std::uint32_t i = 0; i < numThreads; i++) {
+      this->workers.push_back(std::thread(&IoEngine::work, this));
+    }
+  }
+
+  IoEngine::~IoEngine() {
+    {
+      std::lock_guard<std::mutex> guard(this->latch);
+      this->isStopping = true;
+    }
+    this->queueCondition.notify_all();
+    for (std::size_t i = 0; i < this->workers.size(); i++) {
+      this->workers[i].join();
+    }
+  }
+
+  std::future<void> IoEngine::submit(const std::function<void()> &io) {
+    std::packaged_task<void()> task(io);
+    std::future<void> future = task.get_future();
+    {
+      std::lock_guard<std::mutex> guard(this->latch);
+      this->queue.push_back(std::move(task));
+    }
+    this->queueCondition.notify_one();
+    return future;
+  }
+
+  void IoEngine::work() {
+    while (true) {
+      std::packaged_task<void()> task;
+      {
+        std::unique_lock<std::mutex> guard(this->latch);
+        while (this->queue.empty() == true && this->isStopping == false) {
+          this->queueCondition.wait(guard);
+        }
+        if (this->queue.empty() == true) {
+          return;
+        }
+        task = std::move(this->queue.front());
+        this->queue.pop_front();
+      }
+      // the exception of a failed I/O is stored in the future
+      task();
+    }
+  }
+
+}
@@ -0,0 +1,91 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace badgerdb {
+
+  /**
+   * @brief Pool of worker threads doing file I/O on behalf of the buffer
+   *        manager
+   *
+   * An I/O is submitted as a function, and the caller gets a future to wait
+   * on its completion; an exception thrown by the I/O is rethrown by the
+   * future. I/Os are started in the order they are submitted, and as many
+   * run at the same time as there are workers, so a caller that submits
+   * several I/Os before waiting overlaps them.
+   */
+  class IoEngine {
+    private:
+      /**
+       * Worker threads
+       */
+      std::vector<std::thread> workers;
+
+      /**
+       * I/Os submitted and not started yet
+       */
+      std::deque<std::packaged_task<void()> > queue;
+
+      /**
+       * Latch protecting the queue and isStopping
+       */
+      std::mutex latch;
+
+      /**
+       * Signalled when an I/O is submitted or the engine stops
+       */
+      std::condition_variable queueCondition;
+
+      /**
+       * Whether the workers are to exit once the queue is empty
+       */
+      bool isStopping;
+
+      /**
+       * Loop of a worker thread, running the submitted I/Os
+       */
+      void work();
+
+    public:
+      /**
+       * Default number of worker threads
+       */
+      static const std::uint32_t DEFAULT_NUM_THREADS = 4;
+
+      /**
+       * Constructor of IoEngine class
+       *
+       * @param numThreads  Number of worker threads
+       */
+      IoEngine(std::uint32_t numThreads = DEFAULT_NUM_THREADS);
+
+      /**
+       * Destructor of IoEngine class, which finishes the I/Os submitted
+       * and stops the workers
+       */
+      ~IoEngine();
+
+      /**
+       * Submit an I/O
+       *
+       * @param io  Function doing the I/O
+       * @return    Future becoming ready when the I/O is done
+       */
+      std::future<void> submit(const std::function<void()> &io);
+  };
+
+}
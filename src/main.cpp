@@ -14,6 +14,7 @@
 #include <vector>
 #include <regex>
 #include <map>
+#include <thread>
 
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
@@ -28,6 +29,7 @@
 #include "page.h"
 #include "schema.h"
 #include "page_iterator.h"
+#include "replacement_policy.h"
 #include "storage.h"
 
 using namespace badgerdb;
@@ -62,6 +64,7 @@ void createDatabase(BufMgr *bufMgr, Catalog *catalog) {
   int rightTableRows = 100;
 
   std::cout << "creating tuples for " << leftTableFile.filename() << "..." << "\n";
+  vector<string> leftTuples;
   for (int i = 0; i < leftTableRows; i++) {
     if (i % (leftTableRows / 10) == 0) {
       std::cout << (i / (leftTableRows / 100)) << "%...\n";
@@ -70,11 +73,13 @@ void createDatabase(BufMgr *bufMgr, Catalog *catalog) {
     // INSERT INTO r VALUES (string, integer)
     ss << "INSERT INTO r VALUES ('r" << i << "', " << (i % rightTableRows) << ");";
     string tuple = HeapFileManager::createTupleFromSQLStatement(ss.str(), catalog);
-    HeapFileManager::insertTuple(tuple, leftTableFile, bufMgr);
+    leftTuples.push_back(tuple);
 //    std::cout << ss.str() << "\n";
   }
+  HeapFileManager::bulkInsertTuples(leftTuples, leftTableFile, bufMgr);
 
   std::cout << "creating tuples for " << rightTableFile.filename() << "..." << "\n";
+  vector<string> rightTuples;
   for (int i = 0; i < rightTableRows; i++) {
     if (i % (rightTableRows / 10) == 0) {
       std::cout << (i / (rightTableRows / 100)) << "%...\n";
@@ -82,9 +87,10 @@ void createDatabase(BufMgr *bufMgr, Catalog *catalog) {
     stringstream ss;
     ss << "INSERT INTO s VALUES (" << i << ", 's" << i << "');";
     string tuple = HeapFileManager::createTupleFromSQLStatement(ss.str(), catalog);
-    HeapFileManager::insertTuple(tuple, rightTableFile, bufMgr);
+    rightTuples.push_back(tuple);
 //    std::cout << ss.str() << "\n";
   }
+  HeapFileManager::bulkInsertTuples(rightTuples, rightTableFile, bufMgr);
 
   // Print all tuples in tables
   TableScanner leftTableScanner(leftTableFile, leftTableSchema, bufMgr);
@@ -93,6 +99,58 @@ void createDatabase(BufMgr *bufMgr, Catalog *catalog) {
 //  rightTableScanner.print();
 }
 
+void createSkewedDatabase(BufMgr *bufMgr, Catalog *catalog) {
+  // u and v join on b. The values of b below 1000 are found 4 times in u and
+  // twice in v; b = 1000 is found 200 times in both, so that its tuples alone
+  // overflow a small buffer pool.
+  TableSchema leftTableSchema = TableSchema::fromSQLStatement(
+      "CREATE TABLE u (b INT, d CHAR(32));");
+  TableSchema rightTableSchema = TableSchema::fromSQLStatement(
+      "CREATE TABLE v (b INT, e VARCHAR(32));");
+  string leftTableFilename = "u.tbl";
+  string rightTableFilename = "v.tbl";
+  try {
+    File::remove(leftTableFilename);
+    File::remove(rightTableFilename);
+  } catch (FileNotFoundException &e) {
+  }
+  File leftTableFile = File::create(leftTableFilename);
+  File rightTableFile = File::create(rightTableFilename);
+  catalog->addTableSchema(leftTableSchema, leftTableFilename);
+  catalog->addTableSchema(rightTableSchema, rightTableFilename);
+
+  vector<string> leftTuples;
+  for (int i = 0; i < 4200; i++) {
+    stringstream ss;
+    ss << "INSERT INTO u VALUES (" << (i < 4000 ? i % 1000 : 1000) << ", 'u" << i << "');";
+    leftTuples.push_back(HeapFileManager::createTupleFromSQLStatement(ss.str(), catalog));
+  }
+  HeapFileManager::bulkInsertTuples(leftTuples, leftTableFile, bufMgr);
+
+  vector<string> rightTuples;
+  for (int i = 0; i < 2200; i++) {
+    stringstream ss;
+    ss << "INSERT INTO v VALUES (" << (i < 2000 ? i % 1000 : 1000) << ", 'v" << i << "');";
+    rightTuples.push_back(HeapFileManager::createTupleFromSQLStatement(ss.str(), catalog));
+  }
+  HeapFileManager::bulkInsertTuples(rightTuples, rightTableFile, bufMgr);
+}
+
+/*
+ * Run a join into a new result file and print its running statistics.
+ * @return The number of result tuples
+ */
+int runJoin(JoinOperator &joinOperator, int numAvailableBufPages, const string &filename) {
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  File resultFile = File::create(filename);
+  joinOperator.execute(numAvailableBufPages, resultFile);
+  joinOperator.printRunningStats();
+  return joinOperator.getNumResultTuples();
+}
+
 void testOnePassJoin(BufMgr *bufMgr, Catalog *catalog) {
   TableId leftTableId = catalog->getTableId("r");
   TableId rightTableId = catalog->getTableId("s");
@@ -100,8 +158,10 @@ void testOnePassJoin(BufMgr *bufMgr, Catalog *catalog) {
   TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
 
   // Create one-pass join operator
-  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId));
-  File tempRightFile = File::open(catalog->getTableFilename(rightTableId));
+  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File tempRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
   OnePassJoinOperator joinOperator(tempLeftFile, tempRightFile, leftTableSchema,
       rightTableSchema, catalog, bufMgr);
   TableSchema resultSchema = joinOperator.getResultTableSchema();
@@ -124,6 +184,64 @@ void testOnePassJoin(BufMgr *bufMgr, Catalog *catalog) {
   scanner.print();
 }
 
+void testRadixJoin(BufMgr *bufMgr, Catalog *catalog) {
+  TableId leftTableId = catalog->getTableId("r");
+  TableId rightTableId = catalog->getTableId("s");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
+
+  // Create one-pass join operator with a radix-partitioned hash table
+  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File tempRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
+  OnePassJoinOperator joinOperator(tempLeftFile, tempRightFile, leftTableSchema,
+      rightTableSchema, catalog, bufMgr);
+  joinOperator.setRadixPartitioned(true);
+  // r is far smaller than the cache, so partitions of 4 KB are asked for to
+  // have a partitioning pass
+  joinOperator.setRadixPartitionSize(4096);
+  TableSchema resultSchema = joinOperator.getResultTableSchema();
+
+  // Join two tables using one-pass join
+  string filename = leftTableSchema.getTableName() + "_OPJ_radix_"
+      + rightTableSchema.getTableName() + ".tbl";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  File resultFile = File::create(filename);
+  joinOperator.execute(100, resultFile);
+
+  // Print running statistics
+  joinOperator.printRunningStats();
+
+  // Print all tuples in result
+  TableScanner scanner(resultFile, resultSchema, bufMgr);
+  scanner.print();
+
+  // With partitions of 64 bytes, r is partitioned in two passes. Both radix
+  // joins should have as many result tuples as a one-pass join on a map.
+  File onePassLeftFile = File::open(catalog->getTableFilename(leftTableId));
+  File onePassRightFile = File::open(catalog->getTableFilename(rightTableId));
+  File twoPassLeftFile = File::open(catalog->getTableFilename(leftTableId));
+  File twoPassRightFile = File::open(catalog->getTableFilename(rightTableId));
+  OnePassJoinOperator onePassJoinOperator(onePassLeftFile, onePassRightFile,
+      leftTableSchema, rightTableSchema, catalog, bufMgr);
+  OnePassJoinOperator twoPassJoinOperator(twoPassLeftFile, twoPassRightFile,
+      leftTableSchema, rightTableSchema, catalog, bufMgr);
+  twoPassJoinOperator.setRadixPartitioned(true);
+  twoPassJoinOperator.setRadixPartitionSize(64);
+  int numOnePassTuples = runJoin(onePassJoinOperator, 100,
+      leftTableSchema.getTableName() + "_OPJ_map_" + rightTableSchema.getTableName() + ".tbl");
+  int numTwoPassTuples = runJoin(twoPassJoinOperator, 100,
+      leftTableSchema.getTableName() + "_OPJ_radix2_" + rightTableSchema.getTableName()
+          + ".tbl");
+  std::cout << "radix join in one pass: " << joinOperator.getNumResultTuples()
+      << " result tuples, in two passes: " << numTwoPassTuples
+      << " result tuples, one-pass join: " << numOnePassTuples << " result tuples\n";
+}
+
 void testNestedLoopJoin(BufMgr *bufMgr, Catalog *catalog) {
   TableId leftTableId = catalog->getTableId("r");
   TableId rightTableId = catalog->getTableId("s");
@@ -131,8 +249,10 @@ void testNestedLoopJoin(BufMgr *bufMgr, Catalog *catalog) {
   TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
 
   // Create nested-loop join operator
-  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId));
-  File tempRightFile = File::open(catalog->getTableFilename(rightTableId));
+  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File tempRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
   NestedLoopJoinOperator joinOperator(tempLeftFile, tempRightFile, leftTableSchema,
       rightTableSchema, catalog, bufMgr);
   TableSchema resultSchema = joinOperator.getResultTableSchema();
@@ -155,6 +275,495 @@ void testNestedLoopJoin(BufMgr *bufMgr, Catalog *catalog) {
   scanner.print();
 }
 
+void testSortMergeJoin(BufMgr *bufMgr, Catalog *catalog) {
+  TableId leftTableId = catalog->getTableId("r");
+  TableId rightTableId = catalog->getTableId("s");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
+
+  // Create sort-merge join operator
+  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File tempRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
+  SortMergeJoinOperator joinOperator(tempLeftFile, tempRightFile, leftTableSchema,
+      rightTableSchema, catalog, bufMgr);
+  TableSchema resultSchema = joinOperator.getResultTableSchema();
+
+  // Join two tables using sort-merge join
+  string filename = leftTableSchema.getTableName() + "_SMJ_"
+      + rightTableSchema.getTableName() + ".tbl";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  File resultFile = File::create(filename);
+  joinOperator.execute(10, resultFile);
+
+  // Print running statistics
+  joinOperator.printRunningStats();
+
+  // Print all tuples in result
+  TableScanner scanner(resultFile, resultSchema, bufMgr);
+  scanner.print();
+}
+
+void testGraceHashJoin(BufMgr *bufMgr, Catalog *catalog) {
+  TableId leftTableId = catalog->getTableId("r");
+  TableId rightTableId = catalog->getTableId("s");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
+
+  // Create grace hash join operator
+  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File tempRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
+  GraceHashJoinOperator joinOperator(tempLeftFile, tempRightFile, leftTableSchema,
+      rightTableSchema, catalog, bufMgr);
+  TableSchema resultSchema = joinOperator.getResultTableSchema();
+
+  // Join two tables using grace hash join
+  string filename = leftTableSchema.getTableName() + "_GHJ_"
+      + rightTableSchema.getTableName() + ".tbl";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  File resultFile = File::create(filename);
+  joinOperator.execute(10, resultFile);
+
+  // Print running statistics
+  joinOperator.printRunningStats();
+
+  // Print all tuples in result
+  TableScanner scanner(resultFile, resultSchema, bufMgr);
+  scanner.print();
+}
+
+void testGraceHashJoinWithLargeBuckets(BufMgr *bufMgr, Catalog *catalog) {
+  TableId leftTableId = catalog->getTableId("u");
+  TableId rightTableId = catalog->getTableId("v");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
+
+  // Join u and v with 4 buffer pages, so that the buckets of the partition
+  // stage are larger than the buffer pool and are split again, and the bucket
+  // of b = 1000 is joined a block at a time. The result should have as many
+  // tuples as the one of a one-pass join.
+  File onePassLeftFile = File::open(catalog->getTableFilename(leftTableId));
+  File onePassRightFile = File::open(catalog->getTableFilename(rightTableId));
+  File graceHashLeftFile = File::open(catalog->getTableFilename(leftTableId));
+  File graceHashRightFile = File::open(catalog->getTableFilename(rightTableId));
+  OnePassJoinOperator onePassJoinOperator(onePassLeftFile, onePassRightFile,
+      leftTableSchema, rightTableSchema, catalog, bufMgr);
+  GraceHashJoinOperator graceHashJoinOperator(graceHashLeftFile, graceHashRightFile,
+      leftTableSchema, rightTableSchema, catalog, bufMgr);
+  int numOnePassTuples = runJoin(onePassJoinOperator, 100, "u_OPJ_v.tbl");
+  int numGraceHashTuples = runJoin(graceHashJoinOperator, 4, "u_GHJ_v.tbl");
+  std::cout << "grace hash join: " << numGraceHashTuples << " result tuples, one-pass join: "
+      << numOnePassTuples << " result tuples\n";
+}
+
+void testHybridHashJoin(BufMgr *bufMgr, Catalog *catalog) {
+  TableId leftTableId = catalog->getTableId("r");
+  TableId rightTableId = catalog->getTableId("s");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
+
+  // Create hybrid hash join operator
+  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File tempRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
+  HybridHashJoinOperator joinOperator(tempLeftFile, tempRightFile, leftTableSchema,
+      rightTableSchema, catalog, bufMgr);
+  TableSchema resultSchema = joinOperator.getResultTableSchema();
+
+  // Join two tables using hybrid hash join
+  string filename = leftTableSchema.getTableName() + "_HHJ_"
+      + rightTableSchema.getTableName() + ".tbl";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  File resultFile = File::create(filename);
+  joinOperator.execute(50, resultFile);
+
+  // Print running statistics
+  joinOperator.printRunningStats();
+
+  // Print all tuples in result
+  TableScanner scanner(resultFile, resultSchema, bufMgr);
+  scanner.print();
+}
+
+void testHybridHashJoinWithSpilledBuckets(BufMgr *bufMgr, Catalog *catalog) {
+  TableId leftTableId = catalog->getTableId("u");
+  TableId rightTableId = catalog->getTableId("v");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
+
+  // Join u and v with 6 buffer pages, so that only a part of v stays in
+  // memory as bucket 0 and the other buckets are spilled, read back and
+  // probed. The result should have as many tuples as the one of a one-pass
+  // join.
+  File onePassLeftFile = File::open(catalog->getTableFilename(leftTableId));
+  File onePassRightFile = File::open(catalog->getTableFilename(rightTableId));
+  File hybridHashLeftFile = File::open(catalog->getTableFilename(leftTableId));
+  File hybridHashRightFile = File::open(catalog->getTableFilename(rightTableId));
+  OnePassJoinOperator onePassJoinOperator(onePassLeftFile, onePassRightFile,
+      leftTableSchema, rightTableSchema, catalog, bufMgr);
+  HybridHashJoinOperator hybridHashJoinOperator(hybridHashLeftFile, hybridHashRightFile,
+      leftTableSchema, rightTableSchema, catalog, bufMgr);
+  int numOnePassTuples = runJoin(onePassJoinOperator, 100, "u_OPJ_v.tbl");
+  int numHybridHashTuples = runJoin(hybridHashJoinOperator, 6, "u_HHJ_v.tbl");
+  std::cout << "hybrid hash join: " << numHybridHashTuples
+      << " result tuples, one-pass join: " << numOnePassTuples << " result tuples\n";
+}
+
+void testMixedWidthKeys(BufMgr *bufMgr, Catalog *catalog) {
+  // w and x have the attribute a of r, a CHAR(8), as a CHAR(16) and as a
+  // VARCHAR(16). Every other value of a in r is found in w and in x, so each
+  // join should have 250 result tuples.
+  string tableNames[] = { "w", "x" };
+  string attrTypes[] = { "CHAR(16)", "VARCHAR(16)" };
+  TableId leftTableId = catalog->getTableId("r");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  for (int k = 0; k < 2; k++) {
+    TableSchema rightTableSchema = TableSchema::fromSQLStatement(
+        "CREATE TABLE " + tableNames[k] + " (a " + attrTypes[k] + ", d INT);");
+    string rightTableFilename = tableNames[k] + ".tbl";
+    try {
+      File::remove(rightTableFilename);
+    } catch (FileNotFoundException &e) {
+    }
+    File rightTableFile = File::create(rightTableFilename);
+    catalog->addTableSchema(rightTableSchema, rightTableFilename);
+    vector<string> rightTuples;
+    for (int i = 0; i < 500; i += 2) {
+      stringstream ss;
+      ss << "INSERT INTO " << tableNames[k] << " VALUES ('r" << i << "', " << i << ");";
+      rightTuples.push_back(HeapFileManager::createTupleFromSQLStatement(ss.str(), catalog));
+    }
+    HeapFileManager::bulkInsertTuples(rightTuples, rightTableFile, bufMgr);
+
+    File onePassLeftFile = File::open(catalog->getTableFilename(leftTableId));
+    File onePassRightFile = File::open(rightTableFilename);
+    File sortMergeLeftFile = File::open(catalog->getTableFilename(leftTableId));
+    File sortMergeRightFile = File::open(rightTableFilename);
+    OnePassJoinOperator onePassJoinOperator(onePassLeftFile, onePassRightFile,
+        leftTableSchema, rightTableSchema, catalog, bufMgr);
+    SortMergeJoinOperator sortMergeJoinOperator(sortMergeLeftFile, sortMergeRightFile,
+        leftTableSchema, rightTableSchema, catalog, bufMgr);
+    int numOnePassTuples = runJoin(onePassJoinOperator, 100, "r_OPJ_" + tableNames[k] + ".tbl");
+    int numSortMergeTuples = runJoin(sortMergeJoinOperator, 10,
+        "r_SMJ_" + tableNames[k] + ".tbl");
+    std::cout << "r and " << tableNames[k] << " on a " << attrTypes[k] << ": one-pass join: "
+        << numOnePassTuples << " result tuples, sort-merge join: " << numSortMergeTuples
+        << " result tuples\n";
+  }
+}
+
+void testParallelHashJoin(BufMgr *bufMgr, Catalog *catalog) {
+  TableId leftTableId = catalog->getTableId("r");
+  TableId rightTableId = catalog->getTableId("s");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
+
+  // Create parallel hash join operator
+  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File tempRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
+  ParallelHashJoinOperator joinOperator(tempLeftFile, tempRightFile, leftTableSchema,
+      rightTableSchema, catalog, bufMgr);
+  joinOperator.setNumWorkers(4);
+  TableSchema resultSchema = joinOperator.getResultTableSchema();
+
+  // Join two tables using parallel hash join
+  string filename = leftTableSchema.getTableName() + "_PHJ_"
+      + rightTableSchema.getTableName() + ".tbl";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  File resultFile = File::create(filename);
+  joinOperator.execute(10, resultFile);
+
+  // Print running statistics
+  joinOperator.printRunningStats();
+
+  // Print all tuples in result
+  TableScanner scanner(resultFile, resultSchema, bufMgr);
+  scanner.print();
+}
+
+void testConcurrentJoins(BufMgr *bufMgr, Catalog *catalog) {
+  TableId leftTableId = catalog->getTableId("r");
+  TableId rightTableId = catalog->getTableId("s");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
+
+  // Create a sort-merge join operator and a grace hash join operator, each
+  // with its own File objects, since pages are kept apart by File object in
+  // the buffer pool
+  File sortMergeLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File sortMergeRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
+  File graceHashLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File graceHashRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
+  SortMergeJoinOperator sortMergeJoinOperator(sortMergeLeftFile, sortMergeRightFile,
+      leftTableSchema, rightTableSchema, catalog, bufMgr);
+  GraceHashJoinOperator graceHashJoinOperator(graceHashLeftFile, graceHashRightFile,
+      leftTableSchema, rightTableSchema, catalog, bufMgr);
+  TableSchema resultSchema = sortMergeJoinOperator.getResultTableSchema();
+
+  // Run both joins at the same time on the shared buffer pool
+  string sortMergeFilename = leftTableSchema.getTableName() + "_SMJ_"
+      + rightTableSchema.getTableName() + "_concurrent.tbl";
+  string graceHashFilename = leftTableSchema.getTableName() + "_GHJ_"
+      + rightTableSchema.getTableName() + "_concurrent.tbl";
+  try {
+    File::remove(sortMergeFilename);
+  } catch (const FileNotFoundException &e) {
+  }
+  try {
+    File::remove(graceHashFilename);
+  } catch (const FileNotFoundException &e) {
+  }
+  File sortMergeResultFile = File::create(sortMergeFilename);
+  File graceHashResultFile = File::create(graceHashFilename);
+  std::thread sortMergeThread(&JoinOperator::execute, &sortMergeJoinOperator, 10,
+      std::ref(sortMergeResultFile));
+  std::thread graceHashThread(&JoinOperator::execute, &graceHashJoinOperator, 10,
+      std::ref(graceHashResultFile));
+  sortMergeThread.join();
+  graceHashThread.join();
+
+  // Print running statistics
+  sortMergeJoinOperator.printRunningStats();
+  graceHashJoinOperator.printRunningStats();
+
+  // Print all tuples in both results
+  TableScanner sortMergeScanner(sortMergeResultFile, resultSchema, bufMgr);
+  sortMergeScanner.print();
+  TableScanner graceHashScanner(graceHashResultFile, resultSchema, bufMgr);
+  graceHashScanner.print();
+}
+
+void testPipelinedJoins(BufMgr *bufMgr, Catalog *catalog) {
+  TableId leftTableId = catalog->getTableId("r");
+  TableId rightTableId = catalog->getTableId("s");
+  TableSchema leftTableSchema = catalog->getTableSchema(leftTableId);
+  TableSchema rightTableSchema = catalog->getTableSchema(rightTableId);
+
+  // Feed a hybrid hash join of r and s into a one-pass join with s, without
+  // writing the result of the first join to a file. Each scan of s has its
+  // own File object, since pages are kept apart by File object in the buffer
+  // pool
+  File tempLeftFile = File::open(catalog->getTableFilename(leftTableId),
+      true /* map_pages */);
+  File tempRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
+  File tempOuterRightFile = File::open(catalog->getTableFilename(rightTableId),
+      true /* map_pages */);
+  TableScanOperator leftScan(tempLeftFile, leftTableSchema, bufMgr);
+  TableScanOperator rightScan(tempRightFile, rightTableSchema, bufMgr);
+  TableScanOperator outerRightScan(tempOuterRightFile, rightTableSchema, bufMgr);
+  HybridHashJoinOperator hybridHashJoinOperator(leftScan, rightScan, catalog, bufMgr);
+  hybridHashJoinOperator.setNumAvailableBufPages(50);
+  OnePassJoinOperator onePassJoinOperator(hybridHashJoinOperator, outerRightScan, catalog,
+      bufMgr);
+  onePassJoinOperator.setNumAvailableBufPages(100);
+  TableSchema resultSchema = onePassJoinOperator.getResultTableSchema();
+
+  // Pull the tuples of both joins into the result file
+  string filename = leftTableSchema.getTableName() + "_HHJ_"
+      + rightTableSchema.getTableName() + "_OPJ_" + rightTableSchema.getTableName()
+      + ".tbl";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  File resultFile = File::create(filename);
+  FileSink sink(resultFile, bufMgr);
+  sink.write(onePassJoinOperator);
+
+  // the pages of the input tables read through the buffer pool must not
+  // outlive their File objects
+  bufMgr->flushFile(&tempLeftFile);
+  bufMgr->flushFile(&tempRightFile);
+  bufMgr->flushFile(&tempOuterRightFile);
+
+  // Print running statistics
+  hybridHashJoinOperator.printRunningStats();
+  onePassJoinOperator.printRunningStats();
+
+  // Print all tuples in result
+  TableScanner scanner(resultFile, resultSchema, bufMgr);
+  scanner.print();
+}
+
+void testReplacementPolicy(const string &policyName, BufMgr *bufMgr,
+    const string &leftTableFilename, const string &rightTableFilename, BufferRing *ring) {
+  // Read the pages of r sequentially, and after each of them a page out of
+  // the first 16 pages of s, which should stay in the buffer pool. r is read
+  // through the ring if one is given.
+  File leftTableFile = File::open(leftTableFilename);
+  File rightTableFile = File::open(rightTableFilename);
+  vector<PageId> leftPageNos;
+  for (FileIterator itFile = leftTableFile.begin(); itFile != leftTableFile.end();
+      itFile++) {
+    leftPageNos.push_back((*itFile).page_number());
+  }
+  vector<PageId> rightPageNos;
+  for (FileIterator itFile = rightTableFile.begin(); itFile != rightTableFile.end()
+      && rightPageNos.size() < 16; itFile++) {
+    rightPageNos.push_back((*itFile).page_number());
+  }
+
+  Page *page;
+  for (int pass = 0; pass < 2; pass++) {
+    for (std::size_t i = 0; i < leftPageNos.size(); i++) {
+      bufMgr->readPage(&leftTableFile, leftPageNos[i], page, ring);
+      bufMgr->unPinPage(&leftTableFile, leftPageNos[i], false);
+      PageId rightPageNo = rightPageNos[i % rightPageNos.size()];
+      bufMgr->readPage(&rightTableFile, rightPageNo, page);
+      bufMgr->unPinPage(&rightTableFile, rightPageNo, false);
+    }
+  }
+
+  std::cout << policyName << " - ";
+  bufMgr->getBufStats().print();
+  bufMgr->flushFile(&leftTableFile);
+  bufMgr->flushFile(&rightTableFile);
+}
+
+/*
+ * Copy a table to a new file, one tuple per page.
+ */
+void copyTableOneTuplePerPage(const string &tableFilename, const string &copyFilename,
+    BufMgr *bufMgr) {
+  File tableFile = File::open(tableFilename, true /* map_pages */);
+  File copyFile = File::create(copyFilename);
+  Page buffer;
+  for (FileIterator itFile = tableFile.begin(); itFile != tableFile.end(); itFile++) {
+    const Page &page = itFile.view(buffer);
+    for (PageIterator itPage = page.begin(); itPage != page.end(); itPage++) {
+      Page *copyPage;
+      PageId copyPageNo;
+      bufMgr->allocPage(&copyFile, copyPageNo, copyPage);
+      copyPage->insertRecord(itPage.getRecordView());
+      bufMgr->unPinPage(&copyFile, copyPageNo, true);
+    }
+  }
+  bufMgr->flushFile(&copyFile);
+}
+
+void testReplacementPolicies(Catalog *catalog) {
+  // r and s are bulk loaded into a few pages, so the policies are compared on
+  // copies of them with a page for every tuple
+  string leftTableFilename = "r_policy.tbl";
+  string rightTableFilename = "s_policy.tbl";
+  int availableBufPages = 32;
+  BufMgr *bufMgr = new BufMgr(availableBufPages);
+  copyTableOneTuplePerPage(catalog->getTableFilename(catalog->getTableId("r")),
+      leftTableFilename, bufMgr);
+  copyTableOneTuplePerPage(catalog->getTableFilename(catalog->getTableId("s")),
+      rightTableFilename, bufMgr);
+  delete bufMgr;
+
+  bufMgr = new BufMgr(availableBufPages);
+  testReplacementPolicy("Clock", bufMgr, leftTableFilename, rightTableFilename, NULL);
+  delete bufMgr;
+
+  bufMgr = new BufMgr(availableBufPages);
+  BufferRing ring(4, 0 /* readAhead */);
+  testReplacementPolicy("Clock with a scan ring", bufMgr, leftTableFilename,
+      rightTableFilename, &ring);
+  delete bufMgr;
+
+  bufMgr = new BufMgr(availableBufPages);
+  BufferRing readAheadRing(4, 2 /* readAhead */);
+  testReplacementPolicy("Clock with a read-ahead ring", bufMgr, leftTableFilename,
+      rightTableFilename, &readAheadRing);
+  delete bufMgr;
+
+  bufMgr = new BufMgr(availableBufPages, new LruKPolicy(availableBufPages, 2));
+  testReplacementPolicy("LRU-2", bufMgr, leftTableFilename, rightTableFilename, NULL);
+  delete bufMgr;
+
+  bufMgr = new BufMgr(availableBufPages, new TwoQueuePolicy(availableBufPages));
+  testReplacementPolicy("2Q", bufMgr, leftTableFilename, rightTableFilename, NULL);
+  delete bufMgr;
+
+  File::remove(leftTableFilename);
+  File::remove(rightTableFilename);
+}
+
+bool testFreeSpaceMap(Catalog *catalog) {
+  // Insert the tuples of r one by one, delete every other one and insert them
+  // again. The second round of inserts should fill the freed space instead of
+  // allocating pages.
+  string tableFilename = "r_fsm.tbl";
+  BufMgr *bufMgr = new BufMgr(32);
+  bool isPassed;
+  {
+    File tableFile = File::create(tableFilename);
+
+    vector<string> tuples;
+    File leftTableFile = File::open(catalog->getTableFilename(catalog->getTableId("r")),
+        true /* map_pages */);
+    Page buffer;
+    for (FileIterator itFile = leftTableFile.begin(); itFile != leftTableFile.end();
+        itFile++) {
+      const Page &page = itFile.view(buffer);
+      for (PageIterator itPage = page.begin(); itPage != page.end(); itPage++) {
+        tuples.push_back(*itPage);
+      }
+    }
+    vector<RecordId> recIds;
+    for (std::size_t i = 0; i < tuples.size(); i++) {
+      recIds.push_back(HeapFileManager::insertTuple(tuples[i], tableFile, bufMgr));
+    }
+    int numPages = 0;
+    for (FileIterator itFile = tableFile.begin(); itFile != tableFile.end(); itFile++) {
+      numPages++;
+    }
+    std::cout << "after inserting " << tuples.size() << " tuples: " << numPages
+        << " pages\n";
+    int numInsertedPages = numPages;
+
+    for (std::size_t i = 0; i < recIds.size(); i += 2) {
+      HeapFileManager::deleteTuple(recIds[i], tableFile, bufMgr);
+    }
+    for (std::size_t i = 0; i < tuples.size(); i += 2) {
+      HeapFileManager::insertTuple(tuples[i], tableFile, bufMgr);
+    }
+    numPages = 0;
+    for (FileIterator itFile = tableFile.begin(); itFile != tableFile.end(); itFile++) {
+      numPages++;
+    }
+    std::cout << "after deleting and inserting again " << (tuples.size() + 1) / 2
+        << " tuples: " << numPages << " pages\n";
+    isPassed = numPages == numInsertedPages;
+    if (isPassed == false) {
+      std::cout << "FAILED: inserting again allocated " << numPages - numInsertedPages
+          << " pages instead of filling the freed space\n";
+    }
+    bufMgr->flushFile(&tableFile);
+    bufMgr->flushFile(&leftTableFile);
+  }
+
+  delete bufMgr;
+  File::remove(tableFilename);
+  return isPassed;
+}
+
 void myTest() {
 
   map<int, string> mapStudent;
@@ -193,26 +802,77 @@ int main() {
   // Create buffer pool
   int availableBufPages = 256;
   BufMgr *bufMgr = new BufMgr(availableBufPages);
+  // write the pages of the join results back ahead of eviction
+  bufMgr->startBackgroundWriter();
 
 // Create system catalog
   Catalog *catalog = new Catalog("lab3");
 
 // Create tables
   createDatabase(bufMgr, catalog);
+  createSkewedDatabase(bufMgr, catalog);
 
 // Test one-pass join operator
   std::cout << "Test One-Pass Join ..." << endl;
   testOnePassJoin(bufMgr, catalog);
 
+// Test one-pass join operator with a radix-partitioned hash table
+  std::cout << "Test Radix-Partitioned One-Pass Join ..." << endl;
+  testRadixJoin(bufMgr, catalog);
+
 // Test nested-loop join operator
   std::cout << "Test Nested-Loop Join ..." << endl;
   testNestedLoopJoin(bufMgr, catalog);
 
+// Test sort-merge join operator
+  std::cout << "Test Sort-Merge Join ..." << endl;
+  testSortMergeJoin(bufMgr, catalog);
+
+// Test grace hash join operator
+  std::cout << "Test Grace Hash Join ..." << endl;
+  testGraceHashJoin(bufMgr, catalog);
+
+// Test grace hash join operator with buckets larger than the buffer pool
+  std::cout << "Test Grace Hash Join With Large Buckets ..." << endl;
+  testGraceHashJoinWithLargeBuckets(bufMgr, catalog);
+
+// Test hybrid hash join operator
+  std::cout << "Test Hybrid Hash Join ..." << endl;
+  testHybridHashJoin(bufMgr, catalog);
+
+// Test hybrid hash join operator with buckets spilled to disk
+  std::cout << "Test Hybrid Hash Join With Spilled Buckets ..." << endl;
+  testHybridHashJoinWithSpilledBuckets(bufMgr, catalog);
+
+// Test parallel hash join operator
+  std::cout << "Test Parallel Hash Join ..." << endl;
+  testParallelHashJoin(bufMgr, catalog);
+
+// Test joins on string keys of different types and widths
+  std::cout << "Test Mixed-Width Keys ..." << endl;
+  testMixedWidthKeys(bufMgr, catalog);
+
+// Test joins sharing the buffer pool concurrently
+  std::cout << "Test Concurrent Joins ..." << endl;
+  testConcurrentJoins(bufMgr, catalog);
+
+// Test joins pipelined through the iterator interface
+  std::cout << "Test Pipelined Joins ..." << endl;
+  testPipelinedJoins(bufMgr, catalog);
+
+// Test buffer replacement policies
+  std::cout << "Test Replacement Policies ..." << endl;
+  testReplacementPolicies(catalog);
+
+// Test the free-space map of heap files
+  std::cout << "Test Free-Space Map ..." << endl;
+  bool isFreeSpaceMapPassed = testFreeSpaceMap(catalog);
+
 // Destroy objects
   delete bufMgr;
   delete catalog;
 
   std::cout << "Test Completed" << endl;
 
-  return 0;
+  return isFreeSpaceMapPassed == true ? 0 : 1;
 }
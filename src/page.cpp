@@ -6,6 +6,7 @@
  */
 
 #include <cassert>
+#include <cstring>
 
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_record_exception.h"
@@ -27,23 +28,31 @@ void Page::initialize() {
   header_.num_free_slots = 0;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
-  data_.assign(DATA_SIZE, char());
+  std::memset(data_, 0, DATA_SIZE);
 }
 
 RecordId Page::insertRecord(const std::string& record_data) {
-  if (!hasSpaceForRecord(record_data)) {
+  return insertRecord(RecordView(record_data));
+}
+
+RecordId Page::insertRecord(const RecordView& record) {
+  if (!hasSpaceForRecord(record)) {
     throw InsufficientSpaceException(
-        page_number(), record_data.length(), getFreeSpace());
+        page_number(), record.length, getFreeSpace());
   }
   const SlotId slot_number = getAvailableSlot();
-  insertRecordInSlot(slot_number, record_data);
+  insertRecordInSlot(slot_number, record);
   return {page_number(), slot_number};
 }
 
 std::string Page::getRecord(const RecordId& record_id) const {
+  return getRecordView(record_id).str();
+}
+
+RecordView Page::getRecordView(const RecordId& record_id) const {
   validateRecordId(record_id);
   const PageSlot& slot = getSlot(record_id.slot_number);
-  return data_.substr(slot.item_offset, slot.item_length);
+  return RecordView(data_ + slot.item_offset, slot.item_length);
 }
 
 void Page::updateRecord(const RecordId& record_id,
@@ -71,7 +80,7 @@ void Page::deleteRecord(const RecordId& record_id,
                         const bool allow_slot_compaction) {
   validateRecordId(record_id);
   PageSlot* slot = getSlot(record_id.slot_number);
-  data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
+  std::memset(data_ + slot->item_offset, 0, slot->item_length);
 
   // Compact the data by removing the hole left by this record (if necessary).
   std::uint16_t move_offset = slot->item_offset; 
@@ -90,8 +99,8 @@ void Page::deleteRecord(const RecordId& record_id,
   }
   // If we have data to move, shift it to the right.
   if (move_bytes > 0) {
-    const std::string& data_to_move = data_.substr(move_offset, move_bytes);
-    data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+    std::memmove(data_ + move_offset + slot->item_length, data_ + move_offset,
+                 move_bytes);
   }
   header_.free_space_upper_bound += slot->item_length;
 
@@ -123,7 +132,11 @@ void Page::deleteRecord(const RecordId& record_id,
 }
 
 bool Page::hasSpaceForRecord(const std::string& record_data) const {
-  std::size_t record_size = record_data.length();
+  return hasSpaceForRecord(RecordView(record_data));
+}
+
+bool Page::hasSpaceForRecord(const RecordView& record) const {
+  std::size_t record_size = record.length;
   if (header_.num_free_slots == 0) {
     record_size += sizeof(PageSlot);
   }
@@ -165,7 +178,7 @@ SlotId Page::getAvailableSlot() {
 }
 
 void Page::insertRecordInSlot(const SlotId slot_number,
-                              const std::string& record_data) {
+                              const RecordView& record) {
   if (slot_number > header_.num_slots ||
       slot_number == INVALID_SLOT) {
     throw InvalidSlotException(page_number(), slot_number);
@@ -174,13 +187,13 @@ void Page::insertRecordInSlot(const SlotId slot_number,
   if (slot->used) {
     throw SlotInUseException(page_number(), slot_number);
   }
-  const int record_length = record_data.length();
+  const int record_length = record.length;
   slot->used = true;
   slot->item_length = record_length;
   slot->item_offset = header_.free_space_upper_bound - record_length;
   header_.free_space_upper_bound = slot->item_offset;
   --header_.num_free_slots;
-  data_.replace(slot->item_offset, slot->item_length, record_data);
+  std::memcpy(data_ + slot->item_offset, record.data, slot->item_length);
 }
 
 void Page::validateRecordId(const RecordId& record_id) const {
@@ -193,11 +206,11 @@ void Page::validateRecordId(const RecordId& record_id) const {
   }
 }
 
-PageIterator Page::begin() {
+PageIterator Page::begin() const {
   return PageIterator(this);
 }
 
-PageIterator Page::end() {
+PageIterator Page::end() const {
   const RecordId& end_record_id = {page_number(), Page::INVALID_SLOT};
   return PageIterator(this, end_record_id);
 }
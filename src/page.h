@@ -139,6 +139,14 @@ namespace badgerdb {
        */
       RecordId insertRecord(const std::string &record_data);
 
+      /**
+       * Inserts a new record into the page, copying it from a view.
+       *
+       * @param record  View of the bytes that compose the record.
+       * @return  ID of the newly inserted record.
+       */
+      RecordId insertRecord(const RecordView &record);
+
       /**
        * Returns the record with the given ID.  Returned data is a copy of what is
        * stored on the page; use updateRecord to change it.
@@ -149,6 +157,15 @@ namespace badgerdb {
        */
       std::string getRecord(const RecordId &record_id) const;
 
+      /**
+       * Returns a view of the record with the given ID, without copying it.
+       * The view is valid as long as the page is pinned and not changed.
+       *
+       * @param record_id  ID of the record to return.
+       * @return  View of the record.
+       */
+      RecordView getRecordView(const RecordId &record_id) const;
+
       /**
        * Updates the record with the given ID, replacing its data with a new
        * version.  This is equivalent to deleting the old record and inserting a
@@ -176,6 +193,15 @@ namespace badgerdb {
        */
       bool hasSpaceForRecord(const std::string &record_data) const;
 
+      /**
+       * Returns true if the page has enough free space to hold the record in a
+       * view.
+       *
+       * @param record  View of the bytes that compose the record.
+       * @return  Whether the page can hold the data.
+       */
+      bool hasSpaceForRecord(const RecordView &record) const;
+
       /**
        * Returns this page's free space in bytes.
        *
@@ -208,7 +234,7 @@ namespace badgerdb {
        *
        * @return  Iterator at first record of page.
        */
-      PageIterator begin();
+      PageIterator begin() const;
 
       /**
        * Returns an iterator representing the record after the last record in the
@@ -216,7 +242,7 @@ namespace badgerdb {
        *
        * @return  Iterator representing record after the last record in the page.
        */
-      PageIterator end();
+      PageIterator end() const;
 
     private:
       /**
@@ -298,12 +324,12 @@ namespace badgerdb {
        * record before calling this method.
        *
        * @param slot_number   Number of slot to insert record into.
-       * @param record_data   Bytes that compose the record.
+       * @param record        View of the bytes that compose the record.
        * @throws  InvalidSlotException  Thrown when given slot number refers to an
        *                                unallocated slot.
        * @throws  SlotInUseException  Thrown when given slot is in use.
        */
-      void insertRecordInSlot(const SlotId slot_number, const std::string &record_data);
+      void insertRecordInSlot(const SlotId slot_number, const RecordView &record);
 
       /**
        * Throws an exception if the given record ID is not valid for this page
@@ -331,10 +357,10 @@ namespace badgerdb {
 
       /**
        * Data stored on the page.  Includes bookkeeping information about slots as
-       * well as actual content.
+       * well as actual content.  It is held inline, so that a page is a single
+       * block of Page::SIZE bytes and copying one is a memcpy.
        */
-
-      std::string data_;
+      alignas(PageSlot) char data_[DATA_SIZE];
 
       friend class File;
       friend class PageIterator;
@@ -346,5 +372,7 @@ namespace badgerdb {
       "Page size must be large enough to hold header and data.");
   static_assert(Page::DATA_SIZE > 0,
       "Page must have some space to hold data.");
+  static_assert(sizeof(Page) == Page::SIZE,
+      "Page must hold its header and data without padding.");
 
 }
@@ -0,0 +1,237 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "replacement_policy.h"
+
+#include <algorithm>
+
+namespace badgerdb {
+
+  ClockPolicy::ClockPolicy(std::uint32_t bufs) :
+      numBufs(bufs), refbits(new std::atomic<bool>[bufs]) {
+    for (std::uint32_t i = 0; i < bufs; i++) {
+      refbits[i] = false;
+    }
+    clockHand = bufs - 1; // point to the end
+  }
+
+  void ClockPolicy::recordLoad(FrameId frameNo, const File *file, PageId pageNo) {
+    this->refbits[frameNo] = true;
+  }
+
+  void ClockPolicy::recordHit(FrameId frameNo) {
+    this->refbits[frameNo] = true;
+  }
+
+  void ClockPolicy::recordFree(FrameId frameNo) {
+    this->refbits[frameNo] = false;
+  }
+
+  bool ClockPolicy::pickVictim(FrameId &frame, const FrameClaimer &claimer) {
+    std::uint32_t pinnedFrameCount = 0;
+    while (pinnedFrameCount < this->numBufs) {
+      FrameId frameNo = (this->clockHand.fetch_add(1) + 1) % this->numBufs;
+      if (this->refbits[frameNo].exchange(false) == true) {
+        continue;
+      }
+      if (claimer(frameNo) == true) {
+        frame = frameNo;
+        return true;
+      }
+      pinnedFrameCount++;
+    }
+    return false;
+  }
+
+  void ClockPolicy::nextVictims(std::size_t count, std::vector<FrameId> &frames) {
+    // the hand takes the frames not referenced in its first sweep, then the
+    // others in its second sweep, once their reference bits are cleared
+    frames.clear();
+    std::uint32_t hand = this->clockHand.load();
+    for (int sweep = 0; sweep < 2; sweep++) {
+      for (std::uint32_t i = 1; i <= this->numBufs && frames.size() < count; i++) {
+        FrameId frameNo = (hand + i) % this->numBufs;
+        if (this->refbits[frameNo].load() == (sweep == 1)) {
+          frames.push_back(frameNo);
+        }
+      }
+    }
+  }
+
+  LruKPolicy::LruKPolicy(std::uint32_t bufs, int k) :
+      numBufs(bufs), k(k), timer(0), history(new std::atomic<std::uint64_t>[bufs * k]) {
+    for (std::uint32_t i = 0; i < bufs * k; i++) {
+      history[i] = 0;
+    }
+  }
+
+  void LruKPolicy::recordLoad(FrameId frameNo, const File *file, PageId pageNo) {
+    std::atomic<std::uint64_t> *frameHistory = &(this->history[frameNo * this->k]);
+    frameHistory[0] = ++this->timer;
+    for (int i = 1; i < this->k; i++) {
+      frameHistory[i] = 0;
+    }
+  }
+
+  void LruKPolicy::recordHit(FrameId frameNo) {
+    std::atomic<std::uint64_t> *frameHistory = &(this->history[frameNo * this->k]);
+    for (int i = this->k - 1; i > 0; i--) {
+      frameHistory[i] = frameHistory[i - 1].load();
+    }
+    frameHistory[0] = ++this->timer;
+  }
+
+  void LruKPolicy::recordFree(FrameId frameNo) {
+    for (int i = 0; i < this->k; i++) {
+      this->history[frameNo * this->k + i] = 0;
+    }
+  }
+
+  void LruKPolicy::snapshotHistory(std::vector<VictimKey> &keys) const {
+    // compare the K-th most recent accesses, then the most recent ones
+    keys.resize(this->numBufs);
+    for (FrameId i = 0; i < this->numBufs; i++) {
+      const std::atomic<std::uint64_t> *frameHistory = &(this->history[i * this->k]);
+      keys[i] = VictimKey(std::make_pair(frameHistory[this->k - 1].load(),
+          frameHistory[0].load()), i);
+    }
+  }
+
+  bool LruKPolicy::pickVictim(FrameId &frame, const FrameClaimer &claimer) {
+    // Try the frames from the best victim on. The frames that cannot be
+    // claimed are usually few, so the frames are kept in a heap rather than
+    // sorted.
+    std::vector<VictimKey> keys;
+    this->snapshotHistory(keys);
+    std::make_heap(keys.begin(), keys.end(), std::greater<VictimKey>());
+    while (keys.empty() == false) {
+      std::pop_heap(keys.begin(), keys.end(), std::greater<VictimKey>());
+      FrameId frameNo = keys.back().second;
+      keys.pop_back();
+      if (claimer(frameNo) == true) {
+        frame = frameNo;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void LruKPolicy::nextVictims(std::size_t count, std::vector<FrameId> &frames) {
+    std::vector<VictimKey> keys;
+    this->snapshotHistory(keys);
+    count = std::min(count, keys.size());
+    // the same order as pickVictim()
+    std::partial_sort(keys.begin(), keys.begin() + count, keys.end());
+    frames.resize(count);
+    for (std::size_t i = 0; i < count; i++) {
+      frames[i] = keys[i].second;
+    }
+  }
+
+  TwoQueuePolicy::TwoQueuePolicy(std::uint32_t bufs) :
+      maxA1inSize(bufs / 4 > 0 ? bufs / 4 : 1), maxA1outSize(bufs / 2 > 0 ? bufs / 2 : 1),
+      frameQueues(bufs, FREE), framePositions(bufs),
+      framePages(bufs, PageKey((const File*) NULL, (PageId) Page::INVALID_NUMBER)) {
+    for (FrameId i = 0; i < bufs; i++) {
+      this->framePositions[i] = this->freeQueue.insert(this->freeQueue.end(), i);
+    }
+  }
+
+  std::list<FrameId>& TwoQueuePolicy::getQueue(QueueId queueId) {
+    if (queueId == A1IN) {
+      return this->a1inQueue;
+    } else if (queueId == AM) {
+      return this->amQueue;
+    }
+    return this->freeQueue;
+  }
+
+  void TwoQueuePolicy::moveFrame(FrameId frameNo, QueueId queueId) {
+    this->getQueue(this->frameQueues[frameNo]).erase(this->framePositions[frameNo]);
+    std::list<FrameId> &queue = this->getQueue(queueId);
+    this->framePositions[frameNo] = queue.insert(queue.end(), frameNo);
+    this->frameQueues[frameNo] = queueId;
+  }
+
+  bool TwoQueuePolicy::claimFrom(const std::list<FrameId> &queue, FrameId &frame,
+      const FrameClaimer &claimer) {
+    for (std::list<FrameId>::const_iterator it = queue.begin(); it != queue.end(); it++) {
+      if (claimer(*it) == true) {
+        frame = *it;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void TwoQueuePolicy::recordLoad(FrameId frameNo, const File *file, PageId pageNo) {
+    std::lock_guard<std::mutex> guard(this->latch);
+    PageKey pageKey(file, pageNo);
+    this->framePages[frameNo] = pageKey;
+    std::map<PageKey, std::list<PageKey>::iterator>::iterator it = this->a1outIndex.find(
+        pageKey);
+    if (it == this->a1outIndex.end()) {
+      this->moveFrame(frameNo, A1IN);
+    } else {
+      this->a1outQueue.erase(it->second);
+      this->a1outIndex.erase(it);
+      this->moveFrame(frameNo, AM);
+    }
+  }
+
+  void TwoQueuePolicy::recordHit(FrameId frameNo) {
+    std::lock_guard<std::mutex> guard(this->latch);
+    // hits on a page in A1in are taken as correlated with its first access
+    if (this->frameQueues[frameNo] == AM) {
+      this->moveFrame(frameNo, AM);
+    }
+  }
+
+  void TwoQueuePolicy::recordFree(FrameId frameNo) {
+    std::lock_guard<std::mutex> guard(this->latch);
+    if (this->frameQueues[frameNo] == A1IN) {
+      PageKey pageKey = this->framePages[frameNo];
+      this->a1outIndex[pageKey] = this->a1outQueue.insert(this->a1outQueue.end(), pageKey);
+      if (this->a1outQueue.size() > this->maxA1outSize) {
+        this->a1outIndex.erase(this->a1outQueue.front());
+        this->a1outQueue.pop_front();
+      }
+    }
+    this->moveFrame(frameNo, FREE);
+  }
+
+  bool TwoQueuePolicy::pickVictim(FrameId &frame, const FrameClaimer &claimer) {
+    std::lock_guard<std::mutex> guard(this->latch);
+    if (this->claimFrom(this->freeQueue, frame, claimer) == true) {
+      return true;
+    }
+    if (this->a1inQueue.size() > this->maxA1inSize) {
+      return this->claimFrom(this->a1inQueue, frame, claimer)
+          || this->claimFrom(this->amQueue, frame, claimer);
+    }
+    return this->claimFrom(this->amQueue, frame, claimer)
+        || this->claimFrom(this->a1inQueue, frame, claimer);
+  }
+
+  void TwoQueuePolicy::nextVictims(std::size_t count, std::vector<FrameId> &frames) {
+    std::lock_guard<std::mutex> guard(this->latch);
+    frames.clear();
+    // the same order as pickVictim()
+    const std::list<FrameId> *queues[3] = { &(this->freeQueue), &(this->amQueue),
+        &(this->a1inQueue) };
+    if (this->a1inQueue.size() > this->maxA1inSize) {
+      std::swap(queues[1], queues[2]);
+    }
+    for (int i = 0; i < 3; i++) {
+      for (std::list<FrameId>::const_iterator it = queues[i]->begin();
+          it != queues[i]->end() && frames.size() < count; it++) {
+        frames.push_back(*it);
+      }
+    }
+  }
+
+}
@@ -0,0 +1,319 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "file.h"
+
+namespace badgerdb {
+
+  /**
+   * @brief Strategy deciding which frame of the buffer pool to evict
+   *
+   * The buffer manager reports every load, hit and release of a frame to the
+   * policy, and asks it for a victim when it needs a frame. A policy must be
+   * safe to call from several threads.
+   */
+  class ReplacementPolicy {
+    public:
+      /**
+       * Function trying to claim a frame for eviction. It returns true, with
+       * the frame latched, if the frame is not pinned and no other thread is
+       * using it.
+       */
+      typedef std::function<bool(FrameId)> FrameClaimer;
+
+      /**
+       * Destructor of ReplacementPolicy class
+       */
+      virtual ~ReplacementPolicy() {
+      }
+
+      /**
+       * A page has been read into or allocated in the frame
+       *
+       * @param frameNo Frame number
+       * @param file    File object of the page
+       * @param pageNo  Page number in the file
+       */
+      virtual void recordLoad(FrameId frameNo, const File *file, PageId pageNo) = 0;
+
+      /**
+       * The page in the frame has been accessed again
+       *
+       * @param frameNo Frame number
+       */
+      virtual void recordHit(FrameId frameNo) = 0;
+
+      /**
+       * The page in the frame has been dropped from the buffer pool, so the
+       * frame is free
+       *
+       * @param frameNo Frame number
+       */
+      virtual void recordFree(FrameId frameNo) = 0;
+
+      /**
+       * Choose a frame to evict and claim it
+       *
+       * @param frame     Frame reference, the claimed frame is returned via
+       *                  this variable
+       * @param claimer   Function claiming a frame
+       * @return          false if no frame could be claimed
+       */
+      virtual bool pickVictim(FrameId &frame, const FrameClaimer &claimer) = 0;
+
+      /**
+       * List the frames that would be chosen as victims next, the first
+       * victim first, without claiming them or changing the state of the
+       * policy. Pinned frames may be listed.
+       *
+       * @param count   Maximum number of frames to list
+       * @param frames  The frames are returned via this vector
+       */
+      virtual void nextVictims(std::size_t count, std::vector<FrameId> &frames) = 0;
+  };
+
+  /**
+   * @brief Clock (second chance) replacement
+   *
+   * A frame is evicted when the clock hand reaches it with its reference bit
+   * cleared. The hand and the reference bits are atomics, so hits do not
+   * take any latch and threads sweeping at the same time get different
+   * frames.
+   */
+  class ClockPolicy: public ReplacementPolicy {
+    private:
+      /**
+       * Number of frames in the buffer pool
+       */
+      std::uint32_t numBufs;
+
+      /**
+       * Current position of clockhand, taken modulo numBufs
+       */
+      std::atomic<std::uint32_t> clockHand;
+
+      /**
+       * Has each frame been referenced recently
+       */
+      std::unique_ptr<std::atomic<bool>[]> refbits;
+
+    public:
+      /**
+       * Constructor of ClockPolicy class
+       *
+       * @param bufs  Number of frames in the buffer pool
+       */
+      ClockPolicy(std::uint32_t bufs);
+
+      void recordLoad(FrameId frameNo, const File *file, PageId pageNo);
+
+      void recordHit(FrameId frameNo);
+
+      void recordFree(FrameId frameNo);
+
+      bool pickVictim(FrameId &frame, const FrameClaimer &claimer);
+
+      void nextVictims(std::size_t count, std::vector<FrameId> &frames);
+  };
+
+  /**
+   * @brief LRU-K replacement
+   *
+   * The victim is the frame whose K-th most recent access is the oldest.
+   * Frames accessed fewer than K times since their page was loaded go first,
+   * in order of their last access, so a page read once by a scan is evicted
+   * before a page that is used repeatedly.
+   *
+   * The history of a frame is only written under the latch of the hash shard
+   * of its page, so the policy takes no latch of its own and hits on pages
+   * of different shards do not wait for each other. The victims are chosen
+   * from a snapshot of the history, sorted once per call.
+   */
+  class LruKPolicy: public ReplacementPolicy {
+    private:
+      /**
+       * Order of a frame as a victim: the time of its K-th most recent
+       * access, the time of its most recent access, and the frame number
+       */
+      typedef std::pair<std::pair<std::uint64_t, std::uint64_t>, FrameId> VictimKey;
+
+      /**
+       * Number of frames in the buffer pool
+       */
+      std::uint32_t numBufs;
+
+      /**
+       * Number of accesses remembered for each frame
+       */
+      int k;
+
+      /**
+       * Logical time, advanced on every access
+       */
+      std::atomic<std::uint64_t> timer;
+
+      /**
+       * Times of the last k accesses of each frame, the most recent first;
+       * 0 if there was no such access
+       */
+      std::unique_ptr<std::atomic<std::uint64_t>[]> history;
+
+      /**
+       * Get the order of every frame as a victim, from the history as it is
+       * now
+       */
+      void snapshotHistory(std::vector<VictimKey> &keys) const;
+
+    public:
+      /**
+       * Constructor of LruKPolicy class
+       *
+       * @param bufs  Number of frames in the buffer pool
+       * @param k     Number of accesses remembered for each frame
+       */
+      LruKPolicy(std::uint32_t bufs, int k = 2);
+
+      void recordLoad(FrameId frameNo, const File *file, PageId pageNo);
+
+      void recordHit(FrameId frameNo);
+
+      void recordFree(FrameId frameNo);
+
+      bool pickVictim(FrameId &frame, const FrameClaimer &claimer);
+
+      void nextVictims(std::size_t count, std::vector<FrameId> &frames);
+  };
+
+  /**
+   * @brief 2Q replacement
+   *
+   * Newly loaded pages enter a FIFO queue (A1in). Pages evicted from it are
+   * remembered in a ghost queue (A1out), and a page that is loaded again
+   * while remembered there enters an LRU queue (Am). A1in is evicted first
+   * while it holds more than its share of the frames, so a sequential scan
+   * only ever takes that share away from the pages in Am.
+   *
+   * The queues are shared by all frames and kept under a single latch, so
+   * hits on pages of different hash shards still wait for each other. Clock
+   * and LRU-K do not have that limit.
+   */
+  class TwoQueuePolicy: public ReplacementPolicy {
+    private:
+      /**
+       * Queue a frame is in
+       */
+      enum QueueId {
+        FREE, A1IN, AM
+      };
+
+      /**
+       * Identity of a page, as used by the buffer hash table
+       */
+      typedef std::pair<const File*, PageId> PageKey;
+
+      /**
+       * Maximum number of frames in A1in before it is evicted first
+       */
+      std::size_t maxA1inSize;
+
+      /**
+       * Maximum number of pages remembered in A1out
+       */
+      std::size_t maxA1outSize;
+
+      /**
+       * Free frames
+       */
+      std::list<FrameId> freeQueue;
+
+      /**
+       * Frames holding pages loaded once, the oldest first
+       */
+      std::list<FrameId> a1inQueue;
+
+      /**
+       * Frames holding pages loaded again, the least recently used first
+       */
+      std::list<FrameId> amQueue;
+
+      /**
+       * Pages recently evicted from A1in, the oldest first
+       */
+      std::list<PageKey> a1outQueue;
+
+      /**
+       * Position of every page of A1out in a1outQueue
+       */
+      std::map<PageKey, std::list<PageKey>::iterator> a1outIndex;
+
+      /**
+       * Queue of each frame
+       */
+      std::vector<QueueId> frameQueues;
+
+      /**
+       * Position of each frame in its queue
+       */
+      std::vector<std::list<FrameId>::iterator> framePositions;
+
+      /**
+       * Page held by each frame
+       */
+      std::vector<PageKey> framePages;
+
+      /**
+       * Latch protecting the queues, taken by every load, hit and release
+       */
+      std::mutex latch;
+
+      /**
+       * Get the list of a queue
+       */
+      std::list<FrameId>& getQueue(QueueId queueId);
+
+      /**
+       * Move a frame to the end of a queue
+       */
+      void moveFrame(FrameId frameNo, QueueId queueId);
+
+      /**
+       * Claim the first frame of a queue that can be claimed
+       */
+      bool claimFrom(const std::list<FrameId> &queue, FrameId &frame,
+          const FrameClaimer &claimer);
+
+    public:
+      /**
+       * Constructor of TwoQueuePolicy class
+       *
+       * @param bufs  Number of frames in the buffer pool
+       */
+      TwoQueuePolicy(std::uint32_t bufs);
+
+      void recordLoad(FrameId frameNo, const File *file, PageId pageNo);
+
+      void recordHit(FrameId frameNo);
+
+      void recordFree(FrameId frameNo);
+
+      bool pickVictim(FrameId &frame, const FrameClaimer &claimer);
+
+      void nextVictims(std::size_t count, std::vector<FrameId> &frames);
+  };
+
+}
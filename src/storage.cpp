@@ -4,6 +4,8 @@
  * Harbin Institute of Technology, China
  */
 
+#include <cstdio>
+#include <fstream>
 #include <regex>
 #include <iostream>
 
@@ -11,17 +13,104 @@
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/invalid_page_exception.h"
 #include "storage.h"
 #include "buffer.h"
+#include "file_iterator.h"
+#include "tuple.h"
 
 using namespace std;
 
 namespace badgerdb {
 
+  const std::size_t FreeSpaceMap::UNIT_SIZE;
+
+  FreeSpaceMap::FreeSpaceMap(const string &tableFilename) :
+      filename(File::sidecarFilename(tableFilename)), numPages(0), numLeaves(1),
+      tree(2, 0), isDirty(false) {
+    ifstream in(this->filename, ios::binary);
+    if (in) {
+      vector<std::uint8_t> freeUnits((istreambuf_iterator<char>(in)),
+          istreambuf_iterator<char>());
+      while (this->numLeaves < freeUnits.size()) {
+        this->numLeaves *= 2;
+      }
+      this->tree.assign(2 * this->numLeaves, 0);
+      std::copy(freeUnits.begin(), freeUnits.end(),
+          this->tree.begin() + this->numLeaves);
+      for (std::size_t node = this->numLeaves - 1; node > 0; node--) {
+        this->tree[node] = max(this->tree[2 * node], this->tree[2 * node + 1]);
+      }
+      this->numPages = freeUnits.size();
+    }
+  }
+
+  FreeSpaceMap& FreeSpaceMap::of(File &file) {
+    FreeSpaceMap *freeSpaceMap = dynamic_cast<FreeSpaceMap*>(file.attachment());
+    if (freeSpaceMap == NULL) {
+      freeSpaceMap = new FreeSpaceMap(file.filename());
+      file.attach(freeSpaceMap);
+    }
+    return *freeSpaceMap;
+  }
+
+  PageId FreeSpaceMap::findPage(const string &record) const {
+    // a new slot may be needed for the record as well
+    std::size_t recordUnits = (record.length() + sizeof(PageSlot) + UNIT_SIZE - 1)
+        / UNIT_SIZE;
+    if (this->tree[1] < recordUnits) {
+      return Page::INVALID_NUMBER;
+    }
+    // descend to the leftmost leaf with room
+    std::size_t node = 1;
+    while (node < this->numLeaves) {
+      node = this->tree[2 * node] >= recordUnits ? 2 * node : 2 * node + 1;
+    }
+    return node - this->numLeaves;
+  }
+
+  void FreeSpaceMap::update(PageId pageNo, std::size_t freeSpace) {
+    while (pageNo >= this->numLeaves) {
+      this->grow();
+    }
+    this->numPages = max(this->numPages, (std::size_t) pageNo + 1);
+    std::size_t node = this->numLeaves + pageNo;
+    this->tree[node] = (std::uint8_t) min(freeSpace / UNIT_SIZE, (std::size_t) 255);
+    for (node /= 2; node > 0; node /= 2) {
+      this->tree[node] = max(this->tree[2 * node], this->tree[2 * node + 1]);
+    }
+    this->isDirty = true;
+  }
+
+  void FreeSpaceMap::grow() {
+    // the old tree becomes the left subtree of the new root, level by level
+    vector<std::uint8_t> newTree(4 * this->numLeaves, 0);
+    for (std::size_t width = 1; width <= this->numLeaves; width *= 2) {
+      std::copy(this->tree.begin() + width, this->tree.begin() + 2 * width,
+          newTree.begin() + 2 * width);
+    }
+    newTree[1] = this->tree[1];
+    this->tree.swap(newTree);
+    this->numLeaves *= 2;
+  }
+
+  void FreeSpaceMap::flush() {
+    if (this->isDirty == false) {
+      return;
+    }
+    ofstream out(this->filename, ios::binary | ios::trunc);
+    out.write((const char*) &this->tree[this->numLeaves], this->numPages);
+    out.close();
+    if (!out) {
+      throw FileIOException(this->filename, "write");
+    }
+    this->isDirty = false;
+  }
+
   /*
    * Created from an sql statement like "INSERT INTO r VALUES ('string', 32)".
-   * Tuple format:
-   *   "tableName \t attrValue1 \t attrValue2 ..."
+   * Tuple format: the binary layout of the table's schema, see TupleLayout.
    */
 
   RecordId HeapFileManager::insertTuple(const string &tuple, File &file,
@@ -29,9 +118,29 @@ namespace badgerdb {
     Page *page;
     PageId pageNo;
     RecordId recId;
+    FreeSpaceMap &freeSpaceMap = FreeSpaceMap::of(file);
     try {
-      bufMgr->allocPage(&file, pageNo, page);
+      while (true) {
+        pageNo = freeSpaceMap.findPage(tuple);
+        if (pageNo == Page::INVALID_NUMBER) {
+          bufMgr->allocPage(&file, pageNo, page);
+          break;
+        }
+        // the map may be stale, so check the page it points to
+        try {
+          bufMgr->readPage(&file, pageNo, page);
+        } catch (const InvalidPageException &e) {
+          freeSpaceMap.update(pageNo, 0);
+          continue;
+        }
+        if (page->hasSpaceForRecord(tuple) == true) {
+          break;
+        }
+        freeSpaceMap.update(pageNo, page->getFreeSpace());
+        bufMgr->unPinPage(&file, pageNo, false);
+      }
       recId = page->insertRecord(tuple);
+      freeSpaceMap.update(pageNo, page->getFreeSpace());
       bufMgr->unPinPage(&file, pageNo, true);
       bufMgr->flushFile(&file);
     } catch (const BufferExceededException &e) {
@@ -46,12 +155,56 @@ namespace badgerdb {
     return recId;
   }
 
+  vector<RecordId> HeapFileManager::bulkInsertTuples(const vector<string> &tuples,
+      File &file, BufMgr *bufMgr) {
+    vector<RecordId> recIds;
+    Page *page = NULL;
+    PageId pageNo = Page::INVALID_NUMBER;
+    FreeSpaceMap &freeSpaceMap = FreeSpaceMap::of(file);
+    try {
+      // start with the last page of the table, which may have room left
+      for (FileIterator itFile = file.begin(); itFile != file.end(); itFile++) {
+        pageNo = itFile.page_number();
+      }
+      if (pageNo != Page::INVALID_NUMBER) {
+        bufMgr->readPage(&file, pageNo, page);
+      }
+      for (std::size_t i = 0; i < tuples.size(); i++) {
+        if (page == NULL || page->hasSpaceForRecord(tuples[i]) == false) {
+          if (page != NULL) {
+            freeSpaceMap.update(pageNo, page->getFreeSpace());
+            bufMgr->unPinPage(&file, pageNo, true);
+            page = NULL;
+          }
+          bufMgr->allocPage(&file, pageNo, page);
+        }
+        recIds.push_back(page->insertRecord(tuples[i]));
+      }
+      if (page != NULL) {
+        freeSpaceMap.update(pageNo, page->getFreeSpace());
+        bufMgr->unPinPage(&file, pageNo, true);
+        page = NULL;
+      }
+      bufMgr->flushFile(&file);
+    } catch (const BufferExceededException &e) {
+      std::cout << "throws buffer exceeded exception" << "\n";
+    } catch (const PageNotPinnedException &e) {
+      std::cout << "throws page not pinned exception" << "\n";
+    } catch (const BadBufferException &e) {
+      std::cout << "throws bad buffer exception" << "\n";
+    } catch (const PagePinnedException &e) {
+      std::cout << "throws page pinned exception" << "\n";
+    }
+    return recIds;
+  }
+
   void HeapFileManager::deleteTuple(const RecordId &rid, File &file, BufMgr *bufMgr) {
     PageId pageNo = rid.page_number;
     Page *page;
     try {
       bufMgr->readPage(&file, pageNo, page);
       page->deleteRecord(rid);
+      FreeSpaceMap::of(file).update(pageNo, page->getFreeSpace());
       bufMgr->unPinPage(&file, pageNo, true);
       bufMgr->flushFile(&file);
     } catch (const BufferExceededException &e) {
@@ -108,10 +261,12 @@ namespace badgerdb {
     // as this is not the project's main objective
 
     // compose elements into a tuple
-    tuple = tableName;
-    for (uint32_t i = 0; i < attrsVec.size(); i++) {
-      tuple = tuple + "\t" + attrsVec[i];
+    TupleLayout tupleLayout(tableSchema);
+    TupleBuilder tupleBuilder(tupleLayout);
+    for (uint32_t i = 0; i < attrsVec.size() && (int) i < tupleLayout.getAttrCount(); i++) {
+      tupleBuilder.setFromSQL(i, attrsVec[i]);
     }
+    tuple = tupleBuilder.build();
 
     return tuple;
   }
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "buffer.h"
 #include "catalog.h"
 #include "file.h"
@@ -15,16 +17,111 @@ using namespace std;
 
 namespace badgerdb {
 
+  /**
+   * Free-space map of a heap file, persisted in the sidecar file of the table
+   * file (see File::sidecarFilename). It holds one byte per page, the free
+   * space of the page in units of UNIT_SIZE bytes rounded down, so a page
+   * found in the map has at least the space asked for unless the map is
+   * stale. A stale map only costs extra page reads: the heap file manager
+   * checks the page it is pointed to and corrects the entry.
+   *
+   * The map is loaded once per open file and attached to it, so it is shared
+   * by all File objects for the table and written back when the file is
+   * flushed or closed. The bytes are the leaves of a max-tree, whose inner
+   * nodes hold the most free space below them, so the first page with room
+   * for a record is found and updated in O(log pages).
+   */
+  class FreeSpaceMap : public FileAttachment {
+    private:
+      /**
+       * Name of the sidecar file
+       */
+      string filename;
+
+      /**
+       * Number of pages in the map
+       */
+      std::size_t numPages;
+
+      /**
+       * Number of leaves of the tree, a power of two at least numPages
+       */
+      std::size_t numLeaves;
+
+      /**
+       * Max-tree over the free space of the pages: node 1 is the root, the
+       * children of node i are 2i and 2i + 1, and the leaf of page p is node
+       * numLeaves + p
+       */
+      vector<std::uint8_t> tree;
+
+      /**
+       * Whether the map has changed since it was written to its sidecar file
+       */
+      bool isDirty;
+
+      /**
+       * Load the free-space map of a table from its sidecar file, or start an
+       * empty one
+       */
+      FreeSpaceMap(const string &tableFilename);
+
+      /**
+       * Double the number of leaves of the tree
+       */
+      void grow();
+
+    public:
+      /**
+       * Number of bytes represented by one unit of free space
+       */
+      static const std::size_t UNIT_SIZE = Page::SIZE / 256;
+
+      /**
+       * Get the free-space map of a table file, loading it and attaching it
+       * to the file the first time
+       */
+      static FreeSpaceMap& of(File &file);
+
+      /**
+       * Find the first page with room for a record
+       *
+       * @return  Page number, or Page::INVALID_NUMBER if no page has room
+       */
+      PageId findPage(const string &record) const;
+
+      /**
+       * Record the free space of a page
+       */
+      void update(PageId pageNo, std::size_t freeSpace);
+
+      /**
+       * Write the free-space map to its sidecar file if it has changed
+       *
+       * @throws  FileIOException   If the write fails.
+       */
+      void flush();
+  };
+
   /**
    * Heap file manager for inserting and deleting tuples
    */
   class HeapFileManager {
     public:
       /**
-       * Insert a tuple to a table
+       * Insert a tuple to a table. The tuple goes to a page with room for it
+       * according to the free-space map of the table, or to a new page.
        */
       static RecordId insertTuple(const string &tuple, File &file, BufMgr *bufMgr);
 
+      /**
+       * Insert many tuples to a table. The tuples are packed into the last
+       * page of the table and then into new pages, and the table is flushed
+       * once at the end. The free-space map is updated for the pages filled.
+       */
+      static vector<RecordId> bulkInsertTuples(const vector<string> &tuples, File &file,
+          BufMgr *bufMgr);
+
       /**
        * Delete a tuple from a table
        */
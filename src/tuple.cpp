@@ -0,0 +1,258 @@
+/**
+ * @author Zhaonian Zou <znzou@hit.edu.cn>,
+ * School of Computer Science and Technology,
+ * Harbin Institute of Technology, China
+ */
+
+#include "tuple.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace badgerdb {
+
+  TupleLayout::TupleLayout(const TableSchema &tableSchema) {
+    int attrsNum = tableSchema.getAttrCount();
+    this->bitmapSize = (attrsNum + 7) / 8;
+    int offset = this->bitmapSize;
+    for (int i = 0; i < attrsNum; i++) {
+      DataType attrType = tableSchema.getAttrType(i);
+      this->attrTypes.push_back(attrType);
+      this->attrMaxSizes.push_back(tableSchema.getAttrMaxSize(i));
+      this->attrOffsets.push_back(offset);
+      if (attrType == badgerdb::DataType::INT) {
+        offset += sizeof(int32_t);
+      } else if (attrType == badgerdb::DataType::CHAR) {
+        offset += tableSchema.getAttrMaxSize(i);
+      } else {
+        offset += sizeof(uint16_t);
+      }
+    }
+    this->fixedSize = offset;
+  }
+
+  int32_t TupleView::getInt(int num) const {
+    int32_t value;
+    memcpy(&value, this->data + this->layout->getAttrOffset(num), sizeof(value));
+    return value;
+  }
+
+  void TupleView::getBytes(int num, const char *&value, std::size_t &size) const {
+    int offset = this->layout->getAttrOffset(num);
+    DataType attrType = this->layout->getAttrType(num);
+    if (attrType == badgerdb::DataType::INT) {
+      value = this->data + offset;
+      size = sizeof(int32_t);
+    } else if (attrType == badgerdb::DataType::CHAR) {
+      value = this->data + offset;
+      size = this->layout->getAttrMaxSize(num);
+    } else {
+      uint16_t valueOffset;
+      uint16_t valueLength;
+      memcpy(&valueOffset, this->data + offset, sizeof(valueOffset));
+      memcpy(&valueLength, this->data + valueOffset, sizeof(valueLength));
+      value = this->data + valueOffset + sizeof(valueLength);
+      size = valueLength;
+    }
+  }
+
+  string TupleView::getString(int num) const {
+    const char *value;
+    std::size_t size;
+    this->getBytes(num, value, size);
+    if (this->layout->getAttrType(num) == badgerdb::DataType::CHAR) {
+      // drop the padding
+      while (size > 0 && value[size - 1] == '\0') {
+        size--;
+      }
+    }
+    return string(value, size);
+  }
+
+  void TupleView::appendKey(int num, string &key) const {
+    if (this->isNull(num)) {
+      key.push_back('\0');
+      return;
+    }
+    key.push_back('\1');
+    if (this->layout->getAttrType(num) == badgerdb::DataType::INT) {
+      // big-endian with the sign bit flipped, so that the bytes compare by value
+      uint32_t value = ((uint32_t) this->getInt(num)) ^ 0x80000000u;
+      key.push_back((char) (value >> 24));
+      key.push_back((char) (value >> 16));
+      key.push_back((char) (value >> 8));
+      key.push_back((char) value);
+      return;
+    }
+    // a CHAR value without its padding and a VARCHAR value are encoded alike,
+    // so that equal strings have equal keys whatever their types and widths
+    const char *value;
+    std::size_t size;
+    this->getBytes(num, value, size);
+    if (this->layout->getAttrType(num) == badgerdb::DataType::CHAR) {
+      while (size > 0 && value[size - 1] == '\0') {
+        size--;
+      }
+    }
+    key.append(value, size);
+    // terminate the value so that a prefix compares before longer values
+    key.push_back('\0');
+  }
+
+  string TupleView::getValueString(int num) const {
+    if (this->isNull(num)) {
+      return "NULL";
+    }
+    if (this->layout->getAttrType(num) == badgerdb::DataType::INT) {
+      stringstream ss;
+      ss << this->getInt(num);
+      return ss.str();
+    }
+    return "'" + this->getString(num) + "'";
+  }
+
+  string TupleView::toString() const {
+    string text = "";
+    for (int i = 0; i < this->layout->getAttrCount(); i++) {
+      if (i > 0) {
+        text = text + "\t";
+      }
+      text = text + this->getValueString(i);
+    }
+    return text;
+  }
+
+  TupleBuilder::TupleBuilder(const TupleLayout &layout) :
+      layout(layout) {
+    this->clear();
+  }
+
+  void TupleBuilder::clear() {
+    this->fixedPart.assign(this->layout.getFixedSize(), '\0');
+    this->variablePart.clear();
+  }
+
+  void TupleBuilder::setNull(int num) {
+    this->fixedPart[num / 8] |= (char) (1 << (num % 8));
+  }
+
+  void TupleBuilder::setInt(int num, int32_t value) {
+    memcpy(&this->fixedPart[this->layout.getAttrOffset(num)], &value, sizeof(value));
+  }
+
+  void TupleBuilder::setString(int num, const char *value, std::size_t size) {
+    int offset = this->layout.getAttrOffset(num);
+    std::size_t maxSize = this->layout.getAttrMaxSize(num);
+    if (size > maxSize) {
+      size = maxSize;
+    }
+    if (this->layout.getAttrType(num) == badgerdb::DataType::CHAR) {
+      memcpy(&this->fixedPart[offset], value, size);
+      memset(&this->fixedPart[offset + size], '\0', maxSize - size);
+    } else {
+      uint16_t valueOffset = this->layout.getFixedSize() + this->variablePart.length();
+      uint16_t valueLength = size;
+      memcpy(&this->fixedPart[offset], &valueOffset, sizeof(valueOffset));
+      this->variablePart.append(reinterpret_cast<const char*>(&valueLength),
+          sizeof(valueLength));
+      this->variablePart.append(value, size);
+    }
+  }
+
+  void TupleBuilder::setFromSQL(int num, const string &literal) {
+    if (literal == "NULL") {
+      this->setNull(num);
+      return;
+    }
+    string value = literal;
+    if (value.length() >= 2 && value[0] == '\'' && value[value.length() - 1] == '\'') {
+      value = value.substr(1, value.length() - 2);
+    }
+    if (this->layout.getAttrType(num) == badgerdb::DataType::INT) {
+      this->setInt(num, (int32_t) strtol(value.c_str(), NULL, 10));
+    } else {
+      this->setString(num, value.data(), value.length());
+    }
+  }
+
+  void TupleBuilder::copy(int num, const TupleView &view, int viewNum) {
+    if (view.isNull(viewNum)) {
+      this->setNull(num);
+    } else if (this->layout.getAttrType(num) == badgerdb::DataType::INT) {
+      this->setInt(num, view.getInt(viewNum));
+    } else {
+      const char *value;
+      std::size_t size;
+      view.getBytes(viewNum, value, size);
+      this->setString(num, value, size);
+    }
+  }
+
+  TupleBatch::TupleBatch(const TupleLayout &layout) :
+      layout(&layout), intColumns(layout.getAttrCount()), nullColumns(layout.getAttrCount()) {
+    this->data.reserve(CAPACITY * layout.getFixedSize());
+    this->rowOffsets.reserve(CAPACITY);
+    this->selection.reserve(CAPACITY);
+    for (int i = 0; i < layout.getAttrCount(); i++) {
+      if (layout.getAttrType(i) == badgerdb::DataType::INT) {
+        this->intColumns[i].reserve(CAPACITY);
+      }
+      this->nullColumns[i].reserve(CAPACITY);
+    }
+  }
+
+  void TupleBatch::clear() {
+    this->data.clear();
+    this->rowOffsets.clear();
+    this->selection.clear();
+    for (int i = 0; i < this->layout->getAttrCount(); i++) {
+      this->intColumns[i].clear();
+      this->nullColumns[i].clear();
+    }
+  }
+
+  void TupleBatch::append(const RecordView &record) {
+    this->selection.push_back(this->rowOffsets.size());
+    this->rowOffsets.push_back(this->data.size());
+    this->data.append(record.data, record.length);
+
+    TupleView tuple(*(this->layout), record);
+    for (int i = 0; i < this->layout->getAttrCount(); i++) {
+      bool isNull = tuple.isNull(i);
+      this->nullColumns[i].push_back(isNull ? 1 : 0);
+      if (this->layout->getAttrType(i) == badgerdb::DataType::INT) {
+        this->intColumns[i].push_back(isNull ? 0 : tuple.getInt(i));
+      }
+    }
+  }
+
+  void TupleBatch::getKeys(const vector<int> &attrsID, string &keyData,
+      vector<uint32_t> &keyOffsets) const {
+    // the keys share one buffer, and INT attributes are read from their
+    // arrays, so that no string is built per row
+    unsigned int numSelected = this->selection.size();
+    keyData.clear();
+    keyOffsets.resize(numSelected + 1);
+    for (unsigned int i = 0; i < numSelected; i++) {
+      uint16_t row = this->selection[i];
+      keyOffsets[i] = keyData.size();
+      for (unsigned int j = 0; j < attrsID.size(); j++) {
+        int num = attrsID[j];
+        if (this->layout->getAttrType(num) != badgerdb::DataType::INT) {
+          TupleView(*(this->layout), this->getRow(row)).appendKey(num, keyData);
+        } else if (this->nullColumns[num][row] != 0) {
+          keyData.push_back('\0');
+        } else {
+          // the same encoding as TupleView::appendKey
+          uint32_t value = ((uint32_t) this->intColumns[num][row]) ^ 0x80000000u;
+          char bytes[5] = { '\1', (char) (value >> 24), (char) (value >> 16),
+              (char) (value >> 8), (char) value };
+          keyData.append(bytes, sizeof(bytes));
+        }
+      }
+    }
+    keyOffsets[numSelected] = keyData.size();
+  }
+
+} // namespace badgerdb
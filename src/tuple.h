@@ -0,0 +1,395 @@
+/**
+ * @author Zhaonian Zou <znzou@hit.edu.cn>,
+ * School of Computer Science and Technology,
+ * Harbin Institute of Technology, China
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "schema.h"
+#include "types.h"
+
+using namespace std;
+
+namespace badgerdb {
+
+  /**
+   * Binary layout of the tuples of a table, computed from its schema.
+   *
+   * A tuple is stored as
+   *   "null bitmap | fixed part | variable part"
+   * The null bitmap has a bit per attribute. In the fixed part, an INT takes
+   * 4 bytes, a CHAR(n) takes n bytes padded with '\0' and a VARCHAR(n) takes
+   * the 2-byte offset of its value in the variable part, where the value is
+   * stored as a 2-byte length followed by the bytes. So every attribute is at
+   * a fixed offset and reading it does not need to parse the tuple.
+   */
+  class TupleLayout {
+    private:
+      /**
+       * Attribute types
+       */
+      vector<DataType> attrTypes;
+
+      /**
+       * Attribute max sizes
+       */
+      vector<int> attrMaxSizes;
+
+      /**
+       * Offset of each attribute in the fixed part of a tuple
+       */
+      vector<int> attrOffsets;
+
+      /**
+       * Size of the null bitmap in bytes
+       */
+      int bitmapSize;
+
+      /**
+       * Size of the null bitmap and the fixed part in bytes
+       */
+      int fixedSize;
+
+    public:
+      /**
+       * Constructor
+       */
+      TupleLayout(const TableSchema &tableSchema);
+
+      /**
+       * Get the number of attributes
+       */
+      int getAttrCount() const {
+        return attrTypes.size();
+      }
+
+      /**
+       * Get the type of the num-th attribute
+       */
+      DataType getAttrType(int num) const {
+        return attrTypes[num];
+      }
+
+      /**
+       * Get the max size of the num-th attribute
+       */
+      int getAttrMaxSize(int num) const {
+        return attrMaxSizes[num];
+      }
+
+      /**
+       * Get the offset of the num-th attribute in the fixed part
+       */
+      int getAttrOffset(int num) const {
+        return attrOffsets[num];
+      }
+
+      /**
+       * Get the size of the null bitmap and the fixed part
+       */
+      int getFixedSize() const {
+        return fixedSize;
+      }
+  };
+
+  /**
+   * Read-only view of a tuple stored in the binary layout. The view does not
+   * copy the tuple, so the bytes it is created on must outlive it.
+   */
+  class TupleView {
+    private:
+      /**
+       * Layout of the tuple
+       */
+      const TupleLayout *layout;
+
+      /**
+       * Bytes of the tuple
+       */
+      const char *data;
+
+      /**
+       * Number of bytes of the tuple
+       */
+      std::size_t length;
+
+    public:
+      /**
+       * Constructor
+       */
+      TupleView(const TupleLayout &layout, const char *data, std::size_t length) :
+          layout(&layout), data(data), length(length) {
+        // nothing
+      }
+
+      /**
+       * Constructor
+       */
+      TupleView(const TupleLayout &layout, const string &record) :
+          layout(&layout), data(record.data()), length(record.length()) {
+        // nothing
+      }
+
+      /**
+       * Constructor
+       */
+      TupleView(const TupleLayout &layout, const RecordView &record) :
+          layout(&layout), data(record.data), length(record.length) {
+        // nothing
+      }
+
+      /**
+       * Get the layout of the tuple
+       */
+      const TupleLayout& getLayout() const {
+        return *layout;
+      }
+
+      /**
+       * Is the num-th attribute null?
+       */
+      bool isNull(int num) const {
+        return (data[num / 8] & (1 << (num % 8))) != 0;
+      }
+
+      /**
+       * Get the value of the num-th attribute, which is an INT
+       */
+      int32_t getInt(int num) const;
+
+      /**
+       * Get the bytes of the value of the num-th attribute. A CHAR value
+       * includes its padding.
+       */
+      void getBytes(int num, const char *&value, std::size_t &size) const;
+
+      /**
+       * Get the value of the num-th attribute, which is a CHAR or a VARCHAR
+       */
+      string getString(int num) const;
+
+      /**
+       * Append the value of the num-th attribute to a key. Keys compare as
+       * strings in the order of the attribute values, and two values are
+       * equal if and only if their keys are equal. A CHAR value is compared
+       * without its padding, so it is equal to a CHAR value of another width
+       * or a VARCHAR value with the same characters.
+       */
+      void appendKey(int num, string &key) const;
+
+      /**
+       * Get the value of the num-th attribute as text, strings being quoted
+       */
+      string getValueString(int num) const;
+
+      /**
+       * Get the tuple as text, the values separated by tabs
+       */
+      string toString() const;
+  };
+
+  /**
+   * Builder of tuples in the binary layout. Every attribute must be set once
+   * before the tuple is built.
+   */
+  class TupleBuilder {
+    private:
+      /**
+       * Layout of the tuple
+       */
+      const TupleLayout &layout;
+
+      /**
+       * Null bitmap and fixed part
+       */
+      string fixedPart;
+
+      /**
+       * Variable part
+       */
+      string variablePart;
+
+    public:
+      /**
+       * Constructor
+       */
+      TupleBuilder(const TupleLayout &layout);
+
+      /**
+       * Clear the values set so far
+       */
+      void clear();
+
+      /**
+       * Set the num-th attribute to null
+       */
+      void setNull(int num);
+
+      /**
+       * Set the num-th attribute, which is an INT
+       */
+      void setInt(int num, int32_t value);
+
+      /**
+       * Set the num-th attribute, which is a CHAR or a VARCHAR. The value is
+       * truncated to the max size of the attribute.
+       */
+      void setString(int num, const char *value, std::size_t size);
+
+      /**
+       * Set the num-th attribute from an SQL literal, e.g. 32, 'abc' or NULL
+       */
+      void setFromSQL(int num, const string &literal);
+
+      /**
+       * Set the num-th attribute to the viewNum-th attribute of another tuple,
+       * which must be of the same type
+       */
+      void copy(int num, const TupleView &view, int viewNum);
+
+      /**
+       * Get the bytes of the tuple
+       */
+      string build() const {
+        return fixedPart + variablePart;
+      }
+  };
+
+  /**
+   * Batch of up to CAPACITY tuples of the same layout, stored column by
+   * column. The bytes of each tuple are copied into the batch, so the batch
+   * does not depend on the pages the tuples were read from. The INT
+   * attributes and the null flags are also decoded into one array per
+   * attribute, so that loops over an attribute read consecutive values. The
+   * selection vector lists the rows still taking part in the query, in
+   * ascending order.
+   */
+  class TupleBatch {
+    public:
+      /**
+       * Max number of tuples in a batch
+       */
+      static const int CAPACITY = 1024;
+
+    private:
+      /**
+       * Layout of the tuples
+       */
+      const TupleLayout *layout;
+
+      /**
+       * Bytes of the tuples, back to back
+       */
+      string data;
+
+      /**
+       * Offset of each tuple in data
+       */
+      vector<uint32_t> rowOffsets;
+
+      /**
+       * Values of each INT attribute, 0 where the value is null; empty for
+       * the other attributes
+       */
+      vector<vector<int32_t>> intColumns;
+
+      /**
+       * Null flags of each attribute
+       */
+      vector<vector<uint8_t>> nullColumns;
+
+      /**
+       * Rows taking part in the query
+       */
+      vector<uint16_t> selection;
+
+    public:
+      /**
+       * Constructor
+       */
+      TupleBatch(const TupleLayout &layout);
+
+      /**
+       * Get the layout of the tuples
+       */
+      const TupleLayout& getLayout() const {
+        return *layout;
+      }
+
+      /**
+       * Remove all tuples
+       */
+      void clear();
+
+      /**
+       * Add a copy of a tuple and select it. The batch must not be full.
+       */
+      void append(const RecordView &record);
+
+      /**
+       * Get the number of tuples
+       */
+      int getNumRows() const {
+        return rowOffsets.size();
+      }
+
+      /**
+       * Is there no room for another tuple?
+       */
+      bool isFull() const {
+        return getNumRows() >= CAPACITY;
+      }
+
+      /**
+       * Get the bytes of the row-th tuple
+       */
+      RecordView getRow(int row) const {
+        std::size_t end = row + 1 < getNumRows() ? rowOffsets[row + 1] : data.size();
+        return RecordView(data.data() + rowOffsets[row], end - rowOffsets[row]);
+      }
+
+      /**
+       * Get the values of the num-th attribute, which is an INT
+       */
+      const int32_t* getIntColumn(int num) const {
+        return intColumns[num].data();
+      }
+
+      /**
+       * Get the null flags of the num-th attribute
+       */
+      const uint8_t* getNullColumn(int num) const {
+        return nullColumns[num].data();
+      }
+
+      /**
+       * Get the rows taking part in the query
+       */
+      vector<uint16_t>& getSelection() {
+        return selection;
+      }
+
+      /**
+       * Get the rows taking part in the query
+       */
+      const vector<uint16_t>& getSelection() const {
+        return selection;
+      }
+
+      /**
+       * Get the keys of the given attributes of the selected rows, in the
+       * order of the selection, back to back in keyData. The key of the i-th
+       * selected row runs from keyOffsets[i] to keyOffsets[i + 1]. The keys
+       * are the same as those built with TupleView::appendKey.
+       */
+      void getKeys(const vector<int> &attrsID, string &keyData,
+          vector<uint32_t> &keyOffsets) const;
+  };
+
+} // namespace badgerdb
@@ -7,6 +7,10 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
 namespace badgerdb {
 
 /**
@@ -59,4 +63,58 @@ struct RecordId {
   }
 };
 
+/**
+ * @brief Borrowed view of the bytes of a record.
+ *
+ * A view does not copy the record.  A view of a record on a page is valid only
+ * as long as the page stays pinned in the buffer pool and the record is not
+ * changed; a view of a string only as long as the string is not changed.
+ */
+struct RecordView {
+  /**
+   * First byte of the record.
+   */
+  const char* data;
+
+  /**
+   * Number of bytes of the record.
+   */
+  std::size_t length;
+
+  /**
+   * Constructs an empty view.
+   */
+  RecordView()
+      : data(NULL), length(0) {
+  }
+
+  /**
+   * Constructs a view of the given bytes.
+   *
+   * @param data    First byte of the record.
+   * @param length  Number of bytes of the record.
+   */
+  RecordView(const char* data, const std::size_t length)
+      : data(data), length(length) {
+  }
+
+  /**
+   * Constructs a view of the bytes of a string.
+   *
+   * @param record  String holding the record.
+   */
+  RecordView(const std::string& record)
+      : data(record.data()), length(record.length()) {
+  }
+
+  /**
+   * Returns a copy of the record.
+   *
+   * @return  The record.
+   */
+  std::string str() const {
+    return std::string(data, length);
+  }
+};
+
 }